@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""
+Scaling benchmark of the spike_detector_fuse hot path.
+
+For every combination of firing rate, spike multiplicity, number of threads and recording mode, the same
+network is simulated once without and once with a spike_detector_fuse connected to all neurons. The
+difference of the wall-clock times is the total cost of the device, i.e. of handle() for every delivered spike
+and of update() in every slice, and is reported per spike. If the module was configured with
+-Dwith-fuse-stats=ON, the cycles the device counts in handle() and update() are reported separately, per
+spike and per slice of a thread.
+
+Run with e.g.
+
+    python3 benchmark_fuse.py --output benchmark.json
+    python3 benchmark_fuse.py --quick
+
+The results are written as a JSON list with one record per combination, so that the per-spike cost can be
+compared between versions of the module.
+"""
+import argparse
+import itertools
+import json
+import platform
+import time
+
+import numpy as np
+import nest
+
+from stdout_redirector import stdout_discarded
+
+nest.Install('spikedetfusemodule')
+
+RECORDING_MODES = {
+    'memory': {},
+    'count_only': {'count_only': True},
+    'binary': {'binary_output': True},
+    'stream': {'stream_events': True, 'release_consumed': True},
+}
+
+
+def build_network(n_neurons, rate, multiplicity, sim_time, threads, seed):
+    """
+    Create n_neurons parrot neurons, each driven by its own spike_generator emitting Poisson spike trains at
+    the given rate, where every spike has the given multiplicity. Return the neurons and the number of spikes
+    they emit, counting multiplicity.
+    """
+    with stdout_discarded():
+        nest.ResetKernel()
+        nest.SetKernelStatus({'local_num_threads': threads, 'overwrite_files': True})
+
+    rng = np.random.RandomState(seed)
+    resolution = nest.GetKernelStatus('resolution')
+    n_spikes = rng.poisson(rate * sim_time * 1e-3, n_neurons)
+    generators = nest.Create('spike_generator', n_neurons)
+    n_emitted = 0
+    for gen, n in zip(generators, n_spikes):
+        times = np.unique(np.round(rng.uniform(resolution, sim_time, n) / resolution) * resolution)
+        nest.SetStatus([gen], {'spike_times': times, 'spike_multiplicities': [multiplicity] * len(times)})
+        n_emitted += len(times) * multiplicity
+
+    neurons = nest.Create('parrot_neuron', n_neurons)
+    nest.Connect(generators, neurons, 'one_to_one')
+    return neurons, n_emitted
+
+
+def simulate(sim_time):
+    with stdout_discarded():
+        start = time.time()
+        nest.Simulate(sim_time)
+        return time.time() - start
+
+
+def run(n_neurons, rate, multiplicity, threads, mode, sim_time, repeats):
+    """
+    Return the median wall-clock times of the network without and with the device, and the status of the
+    device and the number of spikes emitted in the last run.
+    """
+    baseline, fused = [], []
+    for r in range(repeats):
+        build_network(n_neurons, rate, multiplicity, sim_time, threads, seed=r)
+        baseline.append(simulate(sim_time))
+
+        neurons, n_spikes = build_network(n_neurons, rate, multiplicity, sim_time, threads, seed=r)
+        spike_det = nest.Create('spike_detector_fuse', params=dict(RECORDING_MODES[mode],
+                                                                  frequency_thresh=10 * rate,
+                                                                  length_thresh=100.))
+        nest.Connect(neurons, spike_det)
+        fused.append(simulate(sim_time))
+    return np.median(baseline), np.median(fused), nest.GetStatus(spike_det)[0], n_spikes
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--output', default='benchmark_fuse.json', help="JSON file to write the results to")
+    parser.add_argument('--neurons', type=int, default=10000, help="number of neurons connected to the device")
+    parser.add_argument('--time', type=float, default=1000., help="simulated time per run in ms")
+    parser.add_argument('--repeats', type=int, default=3, help="runs per combination, the median is reported")
+    parser.add_argument('--rates', type=float, nargs='+', default=[5., 20., 80.], help="firing rates in Hz")
+    parser.add_argument('--multiplicities', type=int, nargs='+', default=[1, 4], help="spike multiplicities")
+    parser.add_argument('--threads', type=int, nargs='+', default=[1, 2, 4, 8], help="numbers of threads")
+    parser.add_argument('--modes', nargs='+', default=sorted(RECORDING_MODES), choices=sorted(RECORDING_MODES),
+                        help="recording modes")
+    parser.add_argument('--quick', action='store_true', help="small sweep for a quick check")
+    args = parser.parse_args()
+
+    if args.quick:
+        args.neurons, args.time, args.repeats = 1000, 200., 1
+        args.rates, args.multiplicities, args.threads = [20.], [1], [1, 2]
+
+    results = []
+    for rate, multiplicity, threads, mode in itertools.product(args.rates, args.multiplicities, args.threads,
+                                                               args.modes):
+        t_baseline, t_fused, status, n_spikes = run(args.neurons, rate, multiplicity, threads, mode, args.time,
+                                                    args.repeats)
+        n_slices = int(round(args.time / nest.GetKernelStatus('min_delay')))
+        overhead = max(t_fused - t_baseline, 0.)
+        # only reported if the module was configured with -Dwith-fuse-stats=ON
+        stats = status.get('stats')
+        if stats is not None:
+            # every thread has its own sibling, which is updated once per slice
+            n_spikes = stats['spikes_handled']
+            cycles_per_spike = stats['handle_cycles'] / n_spikes if n_spikes > 0 else None
+            cycles_per_slice = stats['update_cycles'] / (n_slices * threads)
+        else:
+            cycles_per_spike = cycles_per_slice = None
+        record = {
+            'rate': rate,
+            'multiplicity': multiplicity,
+            'threads': threads,
+            'mode': mode,
+            'neurons': args.neurons,
+            'sim_time_ms': args.time,
+            'n_spikes': n_spikes,
+            'n_slices': n_slices,
+            'wall_time_baseline_s': t_baseline,
+            'wall_time_fuse_s': t_fused,
+            'ns_per_spike': 1e9 * overhead / n_spikes if n_spikes > 0 else None,
+            'spikes_per_s': n_spikes / overhead if overhead > 0 else None,
+            'handle_cycles_per_spike': cycles_per_spike,
+            'update_cycles_per_slice': cycles_per_slice,
+            'n_connected_senders': status.get('n_connected_senders'),
+            'stats': stats,
+        }
+        results.append(record)
+        line = "rate {rate:6.1f} Hz  mult {multiplicity}  threads {threads:2d}  {mode:10s}  ".format(**record)
+        line += "{:8.1f} ns/spike".format(record['ns_per_spike']) if n_spikes > 0 else "no spikes"
+        if stats is not None:
+            line += "  handle {:8.1f} cycles/spike  update {:10.0f} cycles/slice".format(
+                cycles_per_spike or 0., cycles_per_slice)
+        print(line)
+
+    with open(args.output, 'w') as f:
+        json.dump({'nest_version': nest.version(),
+                   'host': platform.node(),
+                   'date': time.strftime('%Y-%m-%dT%H:%M:%S'),
+                   'results': results}, f, indent=2)
+    print("Results written to {}".format(args.output))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,723 @@
+/*
+ *  fuse_core.h
+ *
+ *  This file is part of NEST.
+ *
+ *  Copyright (C) 2004 The NEST Initiative
+ *
+ *  NEST is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  NEST is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with NEST.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef FUSE_CORE_H
+#define FUSE_CORE_H
+
+// C includes:
+#include <stdint.h>
+
+// C++ includes:
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+// Includes from this module:
+#include "fuse_kernels.h"
+#include "misc.h"
+
+/*
+ * Fuse logic of the spike_detector_fuse models that does not depend on the
+ * NEST kernel: the lookup of the channel of a sender, the sum of the
+ * per-thread spike counts, the choice of the senders that are recorded, and
+ * the danger and quiescence traces with their calibration and trip decision.
+ * The device only adds the plumbing between threads, processes and the
+ * recording device, so that the core can be tested and profiled on its own,
+ * see fuse_core_test.cpp.
+ */
+
+namespace mynest
+{
+
+/**
+ * GID range of a channel, as used for the lookup in find_channel().
+ */
+struct fuse_gid_range
+{
+  long first; //!< first GID of the range
+  long last;  //!< last GID of the range, inclusive
+  size_t channel;
+
+  bool operator<( const fuse_gid_range& other ) const
+  {
+    return first < other.first;
+  }
+};
+
+/**
+ * Return the channel guarding the given sender, or n_channels if the sender
+ * is not in any of the ranges, which must be sorted by first and must not
+ * overlap. Without ranges, all senders belong to channel 0.
+ */
+inline size_t
+find_channel( const std::vector< fuse_gid_range >& ranges, const long gid, const size_t n_channels )
+{
+  if ( ranges.empty() )
+    return 0;
+
+  // Find the last range starting at or before the sender
+  size_t lo = 0;
+  size_t hi = ranges.size();
+  while ( hi - lo > 1 )
+  {
+    const size_t mid = ( lo + hi ) / 2;
+    if ( ranges[ mid ].first <= gid )
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  const fuse_gid_range& range = ranges[ lo ];
+  return ( range.first <= gid and gid <= range.last ) ? range.channel : n_channels;
+}
+
+/**
+ * Table of per-thread counts, starting on a cache line so that rows padded to
+ * whole cache lines are written by a single thread each.
+ */
+typedef std::vector< double, cache_aligned_allocator< double > > fuse_count_table;
+
+/**
+ * Sum the rows of the given slice in a table of per-thread counts, laid out
+ * as [thread][slice parity][bin] with rows padded to row_stride bins, into
+ * the first row_length bins of sum. All threads sum the rows in the same
+ * order and thus arrive at identical totals.
+ */
+inline void
+sum_count_rows( const fuse_count_table& table,
+  const size_t row_stride,
+  const size_t row_length,
+  const long slice,
+  std::vector< double >& sum )
+{
+  const size_t n_rows = table.size() / row_stride;
+
+  std::fill( sum.begin(), sum.begin() + row_length, 0.0 );
+  for ( size_t r = slice % 2; r < n_rows; r += 2 )
+  {
+    const double* const row = &table[ r * row_stride ];
+    for ( size_t k = 0; k < row_length; ++k )
+      sum[ k ] += row[ k ];
+  }
+}
+
+/**
+ * Index of the bin of a spike emitted in the given step by a sender of the
+ * given channel, in per-step bins laid out as [step][channel]. Spikes are
+ * binned by their step modulo the slice length, so that a thread can bin
+ * them without knowing where the slice starts.
+ */
+inline size_t
+fuse_step_bin( const long step, const long slice_steps, const size_t n_channels, const size_t channel )
+{
+  return ( step % slice_steps ) * n_channels + channel;
+}
+
+/**
+ * Add per-step bins filled by fuse_step_bin() for the slice starting at step
+ * slice_origin to row in the order of the steps of the slice, both laid out
+ * as [step][channel], and clear the bins for the next slice.
+ */
+inline void
+fuse_rotate_bins( double* const bins,
+  double* const row,
+  const long slice_origin,
+  const long slice_steps,
+  const size_t n_channels )
+{
+  const long rotation = ( slice_origin % slice_steps + slice_steps ) % slice_steps;
+  for ( long k = 0; k < slice_steps; ++k )
+  {
+    double* const step_bins = bins + ( ( k + rotation ) % slice_steps ) * n_channels;
+    double* const step_row = row + k * n_channels;
+    for ( size_t c = 0; c < n_channels; ++c )
+    {
+      step_row[ c ] += step_bins[ c ];
+      step_bins[ c ] = 0.0;
+    }
+  }
+}
+
+/**
+ * Choice of the senders whose spikes are recorded. Either an explicit set of
+ * GIDs is recorded, kept as a bitmap over the range they span, or each sender
+ * is recorded with a given probability, decided by a hash of its GID and a
+ * seed. The choice depends on the GID only and is thus the same for any
+ * number of threads and processes, and contains() neither allocates nor
+ * depends on the number of senders.
+ */
+class fuse_gid_sampler
+{
+public:
+  fuse_gid_sampler()
+    : all_( true )
+    , threshold_( 0 )
+    , seed_( 0 )
+    , first_gid_( 0 )
+  {
+  }
+
+  /**
+   * Record the given GIDs if there are any, otherwise each sender with
+   * probability fraction.
+   */
+  void
+  configure( const double fraction, const long seed, const std::vector< long >& gids )
+  {
+    bitmap_.clear();
+    seed_ = static_cast< uint64_t >( seed );
+    all_ = gids.empty() and fraction >= 1.0;
+    threshold_ = fraction > 0.0 and not all_ ? static_cast< uint64_t >( std::ldexp( fraction, 64 ) ) : 0;
+
+    if ( not gids.empty() )
+    {
+      first_gid_ = *std::min_element( gids.begin(), gids.end() );
+      bitmap_.assign( *std::max_element( gids.begin(), gids.end() ) - first_gid_ + 1, false );
+      for ( size_t i = 0; i < gids.size(); ++i )
+        bitmap_[ gids[ i ] - first_gid_ ] = true;
+    }
+  }
+
+  bool
+  contains( const long gid ) const
+  {
+    if ( all_ )
+      return true;
+    if ( not bitmap_.empty() )
+    {
+      // GIDs below first_gid_ wrap around to indices beyond the bitmap
+      const size_t i = static_cast< size_t >( gid - first_gid_ );
+      return i < bitmap_.size() and bitmap_[ i ];
+    }
+    return hash( static_cast< uint64_t >( gid ) ^ seed_ ) < threshold_;
+  }
+
+  /**
+   * Finalizer of SplitMix64, which spreads consecutive GIDs uniformly over
+   * all 64 bit values.
+   */
+  static uint64_t
+  hash( uint64_t x )
+  {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = ( x ^ ( x >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+    x = ( x ^ ( x >> 27 ) ) * 0x94d049bb133111ebULL;
+    return x ^ ( x >> 31 );
+  }
+
+private:
+  bool all_;           //!< record all senders
+  uint64_t threshold_; //!< hashes below this are recorded
+  uint64_t seed_;
+  long first_gid_; //!< GID of the first bit of bitmap_
+  std::vector< bool > bitmap_;
+};
+
+/**
+ * Danger and quiescence traces of all channels of a fuse. The traces are
+ * advanced once per slice with the network-wide spike counts per step and
+ * channel, laid out as [step][channel]. The danger level is computed by the
+ * detection kernel TKernel, the quiescence trace is an exponential trace
+ * calibrated like the danger trace of spike_detector_fuse.
+ *
+ * Optionally, the growth of the danger levels is predicted. After every
+ * slice, the log of the rate of each channel relative to its threshold is
+ * fitted by a straight line over time, by a linear regression in which older
+ * slices are weighted down exponentially. Times are kept relative to the
+ * last slice, so the fit needs six running sums per channel and stays
+ * accurate however long the simulation runs. The rate rather than the danger
+ * level is fitted, as the danger level also rises while it settles to a
+ * constant rate, e.g. at the start of a simulation. If the rate grows
+ * steadily, the danger level grows at the same exponential rate, and the
+ * fuse trips early if this growth takes it from its current value to 1
+ * within the prediction horizon.
+ *
+ * Optionally, the synchrony of each channel is tracked as well. The mean and
+ * variance of the spike count per step are updated with every step, with
+ * exponentially decaying weights in the Welford form, and the fuse trips if
+ * their ratio, the Fano factor, stays above a threshold for long enough.
+ * Independently firing neurons have a Fano factor of about 1, synchronous
+ * bursts raise it in proportion to the number of spikes per burst.
+ */
+template < typename TKernel >
+class fuse_core
+{
+public:
+  /**
+   * Outcome of check().
+   */
+  enum trip
+  {
+    NO_TRIP = 0,
+    UNSTABLE_SPIKING,
+    QUIESCENT_NETWORK,
+    SYNCHRONOUS_SPIKING,
+    PREDICTED_UNSTABLE_SPIKING
+  };
+
+  //! Slices the danger level must have been fitted over before it is trusted
+  static const long MIN_PREDICTION_SLICES = 5;
+
+  fuse_core()
+    : n_channels_( 0 )
+    , horizon_( 0.0 )
+    , prediction_decay_( 0.0 )
+    , min_r_squared_( 0.0 )
+    , log_min_level_( 0.0 )
+    , slice_ms_( 0.0 )
+    , synchrony_thresh_( 0.0 )
+    , synchrony_steps_( 0.0 )
+    , synchrony_weight_( 0.0 )
+  {
+  }
+
+  /**
+   * Prepare for n_channels channels. The constants of all channels are
+   * cleared until they are calibrated again. The traces are kept if the
+   * number of channels does not change, and restarted otherwise.
+   */
+  void
+  resize( const size_t n_channels )
+  {
+    kernel_.resize( n_channels );
+    quiescence_decay_factor_.assign( n_channels, 0.0 );
+    quiescence_increment_step_.assign( n_channels, 0.0 );
+    quiescence_steps_.assign( n_channels, std::numeric_limits< double >::infinity() );
+    threshold_count_.assign( n_channels, 0.0 );
+    if ( n_channels != n_channels_ )
+    {
+      n_channels_ = n_channels;
+      reset();
+    }
+  }
+
+  /**
+   * Calibrate channel c for n_neurons neurons. A pair of thresholds of which
+   * either is 0 disables the corresponding trace of the channel.
+   */
+  void
+  calibrate_channel( const size_t c,
+    const double frequency_thresh,
+    const double length_thresh,
+    const double quiescence_thresh,
+    const double quiescence_length,
+    const double n_neurons,
+    const double step_ms,
+    const long slice_steps )
+  {
+    if ( n_neurons <= 0 )
+      return;
+
+    if ( length_thresh > 0 and frequency_thresh > 0 )
+    {
+      kernel_.calibrate( c, frequency_thresh, length_thresh, n_neurons, step_ms, slice_steps );
+      threshold_count_[ c ] = frequency_thresh * n_neurons * slice_steps * step_ms * 1e-3;
+    }
+
+    // The quiescence trace uses the same calibration with the lower
+    // threshold. The channel is quiescent once the trace stayed below 1 for
+    // quiescence_length.
+    if ( quiescence_length > 0 and quiescence_thresh > 0 )
+    {
+      calibrate_trace( quiescence_thresh,
+        quiescence_length,
+        n_neurons,
+        step_ms,
+        quiescence_decay_factor_[ c ],
+        quiescence_increment_step_[ c ] );
+      quiescence_steps_[ c ] = std::max( 1, int( quiescence_length / step_ms + 0.5 ) );
+    }
+  }
+
+  /**
+   * Set up the prediction of the danger levels, with times in ms and the
+   * length of a slice. The fit weights the slices with exp(-age / window)
+   * and only uses rates of at least min_level times the threshold. A
+   * horizon of 0 disables the prediction.
+   */
+  void
+  configure_prediction( const double horizon,
+    const double window,
+    const double min_r_squared,
+    const double min_level,
+    const double slice_ms )
+  {
+    horizon_ = horizon;
+    prediction_decay_ = std::exp( -slice_ms / std::max( window, slice_ms ) );
+    min_r_squared_ = min_r_squared;
+    log_min_level_ = std::log( min_level );
+    slice_ms_ = slice_ms;
+  }
+
+  /**
+   * Set up the synchrony criterion, with times in ms. The statistics of the
+   * counts per step weight the steps with exp(-age / window), and the fuse
+   * trips once the Fano factor stays above thresh for length. A threshold of
+   * 0 disables the criterion.
+   */
+  void
+  configure_synchrony( const double thresh, const double length, const double window, const double step_ms )
+  {
+    synchrony_thresh_ = thresh;
+    synchrony_steps_ = std::max( 1, int( length / step_ms + 0.5 ) );
+    synchrony_weight_ = 1.0 - std::exp( -step_ms / std::max( window, step_ms ) );
+  }
+
+  /**
+   * Restart all traces. A channel is assumed to fire at the quiescence
+   * threshold initially.
+   */
+  void
+  reset()
+  {
+    danger_level_.assign( n_channels_, 0.0 );
+    max_danger_level_.assign( n_channels_, 0.0 );
+    quiescence_level_.assign( n_channels_, 1.0 );
+    quiet_steps_.assign( n_channels_, 0.0 );
+    max_quiet_steps_.assign( n_channels_, 0.0 );
+    fit_.assign( n_channels_, Fit_() );
+    time_to_threshold_.assign( n_channels_, std::numeric_limits< double >::infinity() );
+    count_mean_.assign( n_channels_, 0.0 );
+    count_variance_.assign( n_channels_, 0.0 );
+    n_counted_steps_.assign( n_channels_, 0.0 );
+    synchronous_steps_.assign( n_channels_, 0.0 );
+    max_synchronous_steps_.assign( n_channels_, 0.0 );
+    peak_count_.assign( n_channels_, 0.0 );
+    kernel_.reset();
+  }
+
+  /**
+   * Log of the weight of a precise spike of channel c per ms of offset.
+   */
+  double
+  offset_decay_rate( const size_t c, const double step_ms ) const
+  {
+    return kernel_.offset_decay_rate( c, step_ms );
+  }
+
+  /**
+   * Advance all traces over n_steps steps, given the spike counts laid out
+   * as [step][channel].
+   */
+  void
+  advance( const double* n_spikes, const long n_steps )
+  {
+    advance( n_spikes, n_spikes, n_steps );
+  }
+
+  /**
+   * Advance all traces over n_steps steps. The danger levels are advanced by
+   * danger_spikes, in which precise spikes may carry a fractional weight,
+   * all other traces by the integer counts n_spikes. Both are laid out as
+   * [step][channel].
+   */
+  void
+  advance( const double* n_spikes, const double* danger_spikes, const long n_steps )
+  {
+    const size_t n_channels = n_channels_;
+    if ( n_channels == 0 )
+      return;
+
+    // The danger levels are advanced by the detection kernel, which is
+    // resolved at compile time
+    kernel_.advance( danger_spikes, n_steps, n_channels, &danger_level_[ 0 ], &max_danger_level_[ 0 ] );
+
+    const double* const q_decay = &quiescence_decay_factor_[ 0 ];
+    const double* const q_increment = &quiescence_increment_step_[ 0 ];
+    double* const quiescence = &quiescence_level_[ 0 ];
+    double* const quiet_steps = &quiet_steps_[ 0 ];
+    double* const max_quiet_steps = &max_quiet_steps_[ 0 ];
+
+    // Steps must be processed in order, the channels of a step are
+    // independent and form the inner loop, which the compiler can vectorize
+    for ( long k = 0; k < n_steps; ++k )
+    {
+      const double* const n = n_spikes + k * n_channels;
+      for ( size_t c = 0; c < n_channels; ++c )
+      {
+        quiescence[ c ] = quiescence[ c ] * q_decay[ c ] + q_increment[ c ] * n[ c ];
+        quiet_steps[ c ] = quiescence[ c ] < 1.0 ? quiet_steps[ c ] + 1.0 : 0.0;
+        max_quiet_steps[ c ] = max_quiet_steps[ c ] < quiet_steps[ c ] ? quiet_steps[ c ] : max_quiet_steps[ c ];
+      }
+    }
+
+    if ( synchrony_thresh_ > 0 )
+      advance_synchrony_( n_spikes, n_steps );
+
+    if ( horizon_ > 0 )
+      for ( size_t c = 0; c < n_channels; ++c )
+      {
+        double n_slice = 0.0;
+        for ( long k = 0; k < n_steps; ++k )
+          n_slice += n_spikes[ k * n_channels + c ];
+        predict_( c, threshold_count_[ c ] > 0 ? n_slice / threshold_count_[ c ] : 0.0 );
+      }
+  }
+
+  /**
+   * Return whether the traces advanced so far trip the fuse, and set channel
+   * to the first channel that trips it. Unstable spiking takes precedence.
+   */
+  trip
+  check( size_t& channel ) const
+  {
+    for ( size_t c = 0; c < n_channels_; ++c )
+      if ( max_danger_level_[ c ] > 1.0 )
+      {
+        channel = c;
+        return UNSTABLE_SPIKING;
+      }
+
+    for ( size_t c = 0; c < n_channels_; ++c )
+      if ( max_quiet_steps_[ c ] >= quiescence_steps_[ c ] )
+      {
+        channel = c;
+        return QUIESCENT_NETWORK;
+      }
+
+    for ( size_t c = 0; c < n_channels_; ++c )
+      if ( synchrony_thresh_ > 0 and max_synchronous_steps_[ c ] >= synchrony_steps_ )
+      {
+        channel = c;
+        return SYNCHRONOUS_SPIKING;
+      }
+
+    for ( size_t c = 0; c < n_channels_; ++c )
+      if ( horizon_ > 0 and time_to_threshold_[ c ] <= horizon_ )
+      {
+        channel = c;
+        return PREDICTED_UNSTABLE_SPIKING;
+      }
+
+    return NO_TRIP;
+  }
+
+  size_t
+  n_channels() const
+  {
+    return n_channels_;
+  }
+
+  const std::vector< double >&
+  danger_level() const
+  {
+    return danger_level_;
+  }
+
+  const std::vector< double >&
+  max_danger_level() const
+  {
+    return max_danger_level_;
+  }
+
+  /**
+   * Predicted time in ms until the danger level of each channel crosses 1,
+   * infinite if no crossing is predicted.
+   */
+  const std::vector< double >&
+  time_to_threshold() const
+  {
+    return time_to_threshold_;
+  }
+
+  /**
+   * Exponentially weighted mean and variance of the spike count per step of
+   * each channel.
+   */
+  const std::vector< double >&
+  count_mean() const
+  {
+    return count_mean_;
+  }
+
+  const std::vector< double >&
+  count_variance() const
+  {
+    return count_variance_;
+  }
+
+  /**
+   * Fano factor of the spike count per step of channel c, 0 without spikes.
+   */
+  double
+  fano_factor( const size_t c ) const
+  {
+    return count_mean_[ c ] > 0.0 ? count_variance_[ c ] / count_mean_[ c ] : 0.0;
+  }
+
+  /**
+   * Highest spike count in a step of the last slice of channel c, divided by
+   * the mean count per step, 0 without spikes.
+   */
+  double
+  peak_to_mean( const size_t c ) const
+  {
+    return count_mean_[ c ] > 0.0 ? peak_count_[ c ] / count_mean_[ c ] : 0.0;
+  }
+
+private:
+  /**
+   * Update the statistics of the counts per step and the time the Fano
+   * factor has been above the threshold.
+   */
+  void
+  advance_synchrony_( const double* n_spikes, const long n_steps )
+  {
+    const size_t n_channels = n_channels_;
+    std::fill( peak_count_.begin(), peak_count_.end(), 0.0 );
+
+    for ( long k = 0; k < n_steps; ++k )
+    {
+      const double* const n = n_spikes + k * n_channels;
+      for ( size_t c = 0; c < n_channels; ++c )
+      {
+        // Exponentially weighted Welford update. Until the window is filled,
+        // all steps so far are weighted equally.
+        n_counted_steps_[ c ] += 1.0;
+        const double weight = std::max( synchrony_weight_, 1.0 / n_counted_steps_[ c ] );
+        const double diff = n[ c ] - count_mean_[ c ];
+        const double increment = weight * diff;
+        count_mean_[ c ] += increment;
+        count_variance_[ c ] = ( 1.0 - weight ) * ( count_variance_[ c ] + diff * increment );
+
+        peak_count_[ c ] = std::max( peak_count_[ c ], n[ c ] );
+        synchronous_steps_[ c ] = fano_factor( c ) > synchrony_thresh_ ? synchronous_steps_[ c ] + 1.0 : 0.0;
+        max_synchronous_steps_[ c ] = std::max( max_synchronous_steps_[ c ], synchronous_steps_[ c ] );
+      }
+    }
+  }
+
+  /**
+   * Exponentially weighted sums of the regression of the log rate level y
+   * over the time t in slices, with t = 0 in the last slice.
+   */
+  struct Fit_
+  {
+    double w;
+    double t;
+    double tt;
+    double y;
+    double yy;
+    double ty;
+    long n_slices;
+
+    Fit_()
+      : w( 0.0 )
+      , t( 0.0 )
+      , tt( 0.0 )
+      , y( 0.0 )
+      , yy( 0.0 )
+      , ty( 0.0 )
+      , n_slices( 0 )
+    {
+    }
+  };
+
+  /**
+   * Add the rate of channel c in the last slice, relative to its threshold,
+   * to its fit and update the predicted time to the threshold.
+   */
+  void
+  predict_( const size_t c, const double level )
+  {
+    Fit_& f = fit_[ c ];
+    time_to_threshold_[ c ] = std::numeric_limits< double >::infinity();
+
+    // Only rates above min_level are fitted, the log of smaller rates is
+    // dominated by noise
+    if ( not( level > 0.0 ) or std::log( level ) < log_min_level_ or not( danger_level_[ c ] > 0.0 ) )
+    {
+      f = Fit_();
+      return;
+    }
+
+    // Age all samples by one slice, i.e. t -> t - 1, weight them down, and
+    // add the new sample at t = 0
+    const double lambda = prediction_decay_;
+    f.tt = lambda * ( f.tt - 2.0 * f.t + f.w );
+    f.ty = lambda * ( f.ty - f.y );
+    f.t = lambda * ( f.t - f.w );
+    f.w = lambda * f.w + 1.0;
+    const double y = std::log( level );
+    f.y = lambda * f.y + y;
+    f.yy = lambda * f.yy + y * y;
+    ++f.n_slices;
+
+    if ( f.n_slices < MIN_PREDICTION_SLICES )
+      return;
+
+    const double mean_t = f.t / f.w;
+    const double mean_y = f.y / f.w;
+    const double var_t = f.tt / f.w - mean_t * mean_t;
+    const double var_y = f.yy / f.w - mean_y * mean_y;
+    const double cov = f.ty / f.w - mean_t * mean_y;
+    if ( not( var_t > 0.0 and var_y > 0.0 and cov > 0.0 ) )
+      return;
+
+    // Trust only a steady growth, i.e. a positive slope explaining most of
+    // the variance. The danger level follows the rate with a lag, but grows
+    // at the same exponential rate, starting from its current value.
+    const double slope = cov / var_t;
+    const double r_squared = cov * cov / ( var_t * var_y );
+    if ( r_squared < min_r_squared_ )
+      return;
+    time_to_threshold_[ c ] = std::max( 0.0, -std::log( danger_level_[ c ] ) / slope ) * slice_ms_;
+  }
+
+  TKernel kernel_; //!< detection statistic with its constants and state
+  size_t n_channels_;
+
+  std::vector< double > quiescence_decay_factor_;
+  std::vector< double > quiescence_increment_step_;
+  std::vector< double > quiescence_steps_; //!< quiescence_length in steps, inf if disabled
+
+  std::vector< double > danger_level_;     //!< network-wide danger per channel
+  std::vector< double > max_danger_level_; //!< highest level reached in any step
+  std::vector< double > quiescence_level_; //!< trace compared to quiescence_thresh
+  std::vector< double > quiet_steps_;      //!< steps since the trace fell below 1
+  std::vector< double > max_quiet_steps_;  //!< longest such run in any step
+  std::vector< double > threshold_count_;  //!< spikes per slice at frequency_thresh
+
+  double horizon_;          //!< prediction horizon in ms, 0 if disabled
+  double prediction_decay_; //!< weight of a sample after one slice
+  double min_r_squared_;    //!< goodness of fit required for a prediction
+  double log_min_level_;    //!< log of the lowest relative rate fitted
+  double slice_ms_;
+  std::vector< Fit_ > fit_;
+  std::vector< double > time_to_threshold_; //!< predicted time to cross 1 in ms
+
+  double synchrony_thresh_; //!< Fano factor of the counts per step, 0 if disabled
+  double synchrony_steps_;  //!< steps above synchrony_thresh_ that trip the fuse
+  double synchrony_weight_; //!< weight of a new step in the count statistics
+  std::vector< double > count_mean_;            //!< mean spike count per step
+  std::vector< double > count_variance_;        //!< variance of the spike count per step
+  std::vector< double > n_counted_steps_;       //!< steps in the count statistics
+  std::vector< double > synchronous_steps_;     //!< steps since the Fano factor rose above the threshold
+  std::vector< double > max_synchronous_steps_; //!< longest such run in any step
+  std::vector< double > peak_count_;            //!< highest count per step in the last slice
+};
+
+} // namespace
+
+#endif /* #ifndef FUSE_CORE_H */
@@ -0,0 +1,622 @@
+/*
+ *  fuse_core_test.cpp
+ *
+ *  This file is part of NEST.
+ *
+ *  Copyright (C) 2004 The NEST Initiative
+ *
+ *  NEST is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  NEST is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with NEST.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Standalone test and benchmark of the fuse core, without NEST. Synthetic
+ * Poisson spike streams are distributed over a number of emulated threads,
+ * binned per step and channel and rotated into the count table with the
+ * helpers used by spike_detector_fuse::handle() and update(), summed over
+ * the threads and fed to the traces once per slice.
+ *
+ *   fuse_core_test                    run the tests
+ *   fuse_core_test --benchmark [N]    process about N million spikes per kernel
+ *
+ * Compiled with SPIKE_DETECTOR_FUSE_STATS, as fuse_core_stats_test, the
+ * emulated threads also keep the counters of the device.
+ */
+
+// C includes:
+#include <sys/wait.h>
+#include <unistd.h>
+
+// C++ includes:
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// Includes from this module:
+#include "fuse_core.h"
+#include "fuse_stats.h"
+#include "fuse_telemetry.h"
+#include "misc.h"
+
+using namespace mynest;
+
+namespace
+{
+
+const double STEP_MS = 0.1;
+const long SLICE_STEPS = 10;
+
+//! First step of the emulated simulation, not at the start of a bin row
+const long ORIGIN_STEP = 3;
+
+int n_failures = 0;
+
+void
+expect( const bool condition, const std::string& what )
+{
+  if ( not condition )
+  {
+    std::printf( "FAILED: %s\n", what.c_str() );
+    ++n_failures;
+  }
+}
+
+/**
+ * Parameters of a channel of the emulated device.
+ */
+struct Channel
+{
+  long first_gid;
+  long last_gid;
+  double frequency_thresh;
+  double length_thresh;
+  double quiescence_thresh;
+  double quiescence_length;
+};
+
+/**
+ * Emulated spike_detector_fuse on n_threads threads of a single process.
+ * Spikes are passed to handle() of the thread of their sender, and slice()
+ * ends a slice as update() does on all siblings.
+ */
+template < typename TKernel >
+class emulated_fuse
+{
+public:
+  emulated_fuse( const std::vector< Channel >& channels, const size_t n_threads )
+    : n_channels_( channels.size() )
+    , n_threads_( n_threads )
+    , slice_( 0 )
+  {
+    for ( size_t c = 0; c < n_channels_; ++c )
+    {
+      const fuse_gid_range range = { channels[ c ].first_gid, channels[ c ].last_gid, c };
+      ranges_.push_back( range );
+    }
+    std::sort( ranges_.begin(), ranges_.end() );
+
+    core_.resize( n_channels_ );
+    for ( size_t c = 0; c < n_channels_; ++c )
+      core_.calibrate_channel( c,
+        channels[ c ].frequency_thresh,
+        channels[ c ].length_thresh,
+        channels[ c ].quiescence_thresh,
+        channels[ c ].quiescence_length,
+        channels[ c ].last_gid - channels[ c ].first_gid + 1,
+        STEP_MS,
+        SLICE_STEPS );
+
+    row_length_ = SLICE_STEPS * n_channels_;
+    const size_t doubles_per_line = CACHE_LINE_SIZE / sizeof( double );
+    row_stride_ = ( row_length_ + doubles_per_line - 1 ) / doubles_per_line * doubles_per_line;
+    table_.assign( n_threads_ * 2 * row_stride_, 0.0 );
+    bins_.assign( n_threads_, std::vector< double >( row_length_, 0.0 ) );
+    sum_.assign( row_length_, 0.0 );
+#ifdef SPIKE_DETECTOR_FUSE_STATS
+    stats_.resize( n_threads_ );
+#endif
+  }
+
+  /**
+   * Bin a spike of the given sender emitted in the given step of the current
+   * slice.
+   */
+  void
+  handle( const long gid, const long step )
+  {
+#ifdef SPIKE_DETECTOR_FUSE_STATS
+    FuseStats& stats = stats_[ gid % n_threads_ ];
+    CycleTimer timer( stats.handle_cycles );
+    ++stats.spikes_handled;
+#endif
+    const size_t channel = find_channel( ranges_, gid, n_channels_ );
+    if ( channel < n_channels_ )
+      bins_[ gid % n_threads_ ][ fuse_step_bin( slice_origin_() + step, SLICE_STEPS, n_channels_, channel ) ] += 1.0;
+  }
+
+  /**
+   * Move the bins of all threads to their rows, sum the counts of the current
+   * slice, advance the traces and return whether the fuse trips.
+   */
+  typename fuse_core< TKernel >::trip
+  slice()
+  {
+    for ( size_t t = 0; t < n_threads_; ++t )
+      fuse_rotate_bins( &bins_[ t ][ 0 ], row_( t, slice_ ), slice_origin_(), SLICE_STEPS, n_channels_ );
+    sum_count_rows( table_, row_stride_, row_length_, slice_, sum_ );
+    core_.advance( &sum_[ 0 ], SLICE_STEPS );
+
+    ++slice_;
+    for ( size_t t = 0; t < n_threads_; ++t )
+      std::fill( row_( t, slice_ ), row_( t, slice_ ) + row_length_, 0.0 );
+
+    size_t channel;
+    return core_.check( channel );
+  }
+
+  const fuse_core< TKernel >&
+  core() const
+  {
+    return core_;
+  }
+
+#ifdef SPIKE_DETECTOR_FUSE_STATS
+  /**
+   * Number of spikes handled by all threads, summed as get_status() does.
+   */
+  uint64_t
+  spikes_handled() const
+  {
+    uint64_t total = 0;
+    for ( size_t t = 0; t < n_threads_; ++t )
+      total += stats_[ t ].spikes_handled;
+    return total;
+  }
+#endif
+
+  /**
+   * Trip if the threshold is predicted to be crossed within horizon ms, with
+   * the default settings of the device.
+   */
+  void
+  predict( const double horizon )
+  {
+    core_.configure_prediction( horizon, 20.0, 0.95, 0.1, SLICE_STEPS * STEP_MS );
+  }
+
+  /**
+   * Trip if the Fano factor of the counts per step exceeds thresh for 100 ms.
+   */
+  void
+  synchrony( const double thresh )
+  {
+    core_.configure_synchrony( thresh, 100.0, 100.0, STEP_MS );
+  }
+
+private:
+  long
+  slice_origin_() const
+  {
+    return ORIGIN_STEP + slice_ * SLICE_STEPS;
+  }
+
+  double*
+  row_( const size_t thread, const long slice )
+  {
+    return &table_[ ( 2 * thread + slice % 2 ) * row_stride_ ];
+  }
+
+  size_t n_channels_;
+  size_t n_threads_;
+  long slice_;
+  std::vector< fuse_gid_range > ranges_;
+  fuse_core< TKernel > core_;
+  size_t row_length_;
+  size_t row_stride_;
+  fuse_count_table table_;
+  std::vector< std::vector< double > > bins_; //!< per-thread bins by step modulo the slice length
+  std::vector< double > sum_;
+#ifdef SPIKE_DETECTOR_FUSE_STATS
+  std::vector< FuseStats > stats_; //!< counters of each emulated thread
+#endif
+};
+
+/**
+ * Draw the spikes of n_neurons neurons starting at first_gid firing as
+ * Poisson processes at rate Hz for one slice.
+ */
+void
+draw_slice( std::mt19937& rng,
+  const long first_gid,
+  const long n_neurons,
+  const double rate,
+  std::vector< long >& gids,
+  std::vector< long >& steps )
+{
+  std::poisson_distribution< long > n_spikes( n_neurons * rate * STEP_MS * 1e-3 );
+  std::uniform_int_distribution< long > sender( first_gid, first_gid + n_neurons - 1 );
+  for ( long k = 0; k < SLICE_STEPS; ++k )
+    for ( long n = n_spikes( rng ); n > 0; --n )
+    {
+      gids.push_back( sender( rng ) );
+      steps.push_back( k );
+    }
+}
+
+/**
+ * Run a single channel of n_neurons at rate Hz for at most t_max ms and
+ * return the time at which the fuse tripped, or -1. If growth is positive,
+ * the rate grows by a factor of e every growth ms. If horizon is positive,
+ * the fuse predicts crossings within horizon ms.
+ */
+template < typename TKernel >
+double
+time_to_trip( const Channel& channel,
+  const double rate,
+  const double t_max,
+  const size_t n_threads,
+  const double growth = 0.0,
+  const double horizon = 0.0 )
+{
+  std::mt19937 rng( 12345 );
+  emulated_fuse< TKernel > fuse( std::vector< Channel >( 1, channel ), n_threads );
+  fuse.predict( horizon );
+  const long n_neurons = channel.last_gid - channel.first_gid + 1;
+  std::vector< long > gids, steps;
+
+  for ( long s = 0; s * SLICE_STEPS * STEP_MS < t_max; ++s )
+  {
+    const double t = s * SLICE_STEPS * STEP_MS;
+    gids.clear();
+    steps.clear();
+    draw_slice( rng, channel.first_gid, n_neurons, growth > 0 ? rate * std::exp( t / growth ) : rate, gids, steps );
+    for ( size_t i = 0; i < gids.size(); ++i )
+      fuse.handle( gids[ i ], steps[ i ] );
+    if ( fuse.slice() != fuse_core< TKernel >::NO_TRIP )
+      return ( s + 1 ) * SLICE_STEPS * STEP_MS;
+  }
+  return -1.0;
+}
+
+template < typename TKernel >
+void
+test_kernel( const std::string& name )
+{
+  const Channel channel = { 1, 1000, 50.0, 100.0, 0.0, 0.0 };
+
+  // Half the threshold rate must not trip, twice the rate must trip after
+  // about length_thresh. The CUSUM statistic reaches 1 after length_thresh
+  // on average, so some slack is left for the Poisson noise.
+  expect( time_to_trip< TKernel >( channel, 25.0, 2000.0, 4 ) < 0, name + ": no trip below threshold" );
+  const double t_trip = time_to_trip< TKernel >( channel, 100.0, 2000.0, 4 );
+  expect( t_trip > 0 and t_trip <= 1.5 * channel.length_thresh, name + ": trip at twice the threshold" );
+
+  // The outcome does not depend on the distribution over threads
+  expect( time_to_trip< TKernel >( channel, 100.0, 2000.0, 1 ) == t_trip, name + ": independent of threads" );
+
+  // A silent network is quiescent after quiescence_length
+  const Channel quiet = { 1, 1000, 50.0, 100.0, 5.0, 50.0 };
+  const double t_quiet = time_to_trip< TKernel >( quiet, 0.0, 2000.0, 4 );
+  expect( t_quiet >= quiet.quiescence_length and t_quiet <= quiet.quiescence_length + SLICE_STEPS * STEP_MS,
+    name + ": quiescent after quiescence_length" );
+}
+
+template < typename TKernel >
+void
+test_prediction( const std::string& name )
+{
+  const Channel channel = { 1, 1000, 50.0, 100.0, 0.0, 0.0 };
+
+  // An exponentially growing rate trips earlier with prediction, a constant
+  // rate below the threshold does not trip
+  const double t_plain = time_to_trip< TKernel >( channel, 5.0, 2000.0, 4, 20.0 );
+  const double t_predicted = time_to_trip< TKernel >( channel, 5.0, 2000.0, 4, 20.0, 20.0 );
+  expect( t_predicted > 0 and t_predicted < t_plain, name + ": prediction trips earlier" );
+  expect( time_to_trip< TKernel >( channel, 35.0, 2000.0, 4, 0.0, 20.0 ) < 0, name + ": no prediction below threshold" );
+}
+
+/**
+ * Run 1000 neurons firing at 20 Hz, either as Poisson processes or in
+ * synchronous bursts of 100 neurons, and return the outcome after 1000 ms.
+ */
+template < typename TKernel >
+typename fuse_core< TKernel >::trip
+synchrony_outcome( const bool bursts, double& fano_factor )
+{
+  const Channel channel = { 1, 1000, 100.0, 100.0, 0.0, 0.0 };
+  emulated_fuse< TKernel > fuse( std::vector< Channel >( 1, channel ), 4 );
+  fuse.synchrony( 5.0 );
+
+  std::mt19937 rng( 12345 );
+  std::uniform_int_distribution< long > step( 0, SLICE_STEPS - 1 );
+  std::vector< long > gids, steps;
+  typename fuse_core< TKernel >::trip trip = fuse_core< TKernel >::NO_TRIP;
+  for ( long s = 0; s < 1000 and trip == fuse_core< TKernel >::NO_TRIP; ++s )
+  {
+    gids.clear();
+    steps.clear();
+    if ( not bursts )
+      draw_slice( rng, 1, 1000, 20.0, gids, steps );
+    else if ( s % 5 == 0 )
+    {
+      // 100 neurons fire in the same step every 5 ms, i.e. 20 spikes/ms
+      const long burst_step = step( rng );
+      for ( long n = 0; n < 100; ++n )
+      {
+        gids.push_back( 1 + ( s / 5 * 100 + n ) % 1000 );
+        steps.push_back( burst_step );
+      }
+    }
+    for ( size_t i = 0; i < gids.size(); ++i )
+      fuse.handle( gids[ i ], steps[ i ] );
+    trip = fuse.slice();
+  }
+  fano_factor = fuse.core().fano_factor( 0 );
+  return trip;
+}
+
+template < typename TKernel >
+void
+test_synchrony( const std::string& name )
+{
+  double fano_factor;
+  expect( synchrony_outcome< TKernel >( false, fano_factor ) == fuse_core< TKernel >::NO_TRIP
+      and std::fabs( fano_factor - 1.0 ) < 0.2,
+    name + ": Poisson spiking is not synchronous" );
+  expect( synchrony_outcome< TKernel >( true, fano_factor ) == fuse_core< TKernel >::SYNCHRONOUS_SPIKING,
+    name + ": bursts trip the synchrony criterion" );
+}
+
+void
+test_calibration()
+{
+  // A constant count at the threshold rate converges to 1
+  exponential_kernel kernel;
+  kernel.resize( 1 );
+  kernel.calibrate( 0, 50.0, 100.0, 1000, STEP_MS, SLICE_STEPS );
+  const std::vector< double > n_spikes( 50000, 1000 * 50.0 * STEP_MS * 1e-3 );
+  double danger = 0.0;
+  double max_danger = 0.0;
+  kernel.advance( &n_spikes[ 0 ], n_spikes.size(), 1, &danger, &max_danger );
+  expect( std::fabs( danger - 1.0 ) < 1e-9 and max_danger <= 1.0 + 1e-9, "calibration: steady state 1" );
+}
+
+void
+test_channels()
+{
+  std::vector< fuse_gid_range > ranges;
+  const fuse_gid_range a = { 1, 10, 0 };
+  const fuse_gid_range b = { 21, 30, 1 };
+  const fuse_gid_range c = { 31, 31, 0 };
+  ranges.push_back( a );
+  ranges.push_back( b );
+  ranges.push_back( c );
+
+  expect( find_channel( ranges, 1, 2 ) == 0 and find_channel( ranges, 10, 2 ) == 0, "channels: first range" );
+  expect( find_channel( ranges, 11, 2 ) == 2 and find_channel( ranges, 32, 2 ) == 2, "channels: outside" );
+  expect( find_channel( ranges, 25, 2 ) == 1 and find_channel( ranges, 31, 2 ) == 0, "channels: later ranges" );
+  expect( find_channel( std::vector< fuse_gid_range >(), 7, 1 ) == 0, "channels: no ranges" );
+}
+
+void
+test_count_table()
+{
+  // The table starts on a cache line for any size, and the rows of a slice
+  // parity are summed
+  for ( size_t n_rows = 1; n_rows <= 8; ++n_rows )
+  {
+    fuse_count_table table( n_rows * 8, 1.0 );
+    expect( reinterpret_cast< uintptr_t >( &table[ 0 ] ) % CACHE_LINE_SIZE == 0, "count table: alignment" );
+  }
+  fuse_count_table table( 4 * 8, 1.0 );
+  table[ 2 * 8 + 1 ] = 5.0;
+  std::vector< double > sum( 3, -1.0 );
+  sum_count_rows( table, 8, 3, 2, sum );
+  expect( sum[ 0 ] == 2.0 and sum[ 1 ] == 6.0 and sum[ 2 ] == 2.0, "count table: sum of even rows" );
+
+  // Bins filled by step modulo the slice length are moved to the row in the
+  // order of the steps of the slice. Only the origin modulo the slice length
+  // matters, so an origin one slice earlier, possibly before step 0, gives
+  // the same order.
+  for ( long origin = 0; origin <= 2 * SLICE_STEPS; origin += 7 )
+  {
+    std::vector< double > bins( SLICE_STEPS * 2, 0.0 );
+    std::vector< double > row( SLICE_STEPS * 2, 0.0 );
+    for ( long k = 0; k < SLICE_STEPS; ++k )
+      bins[ fuse_step_bin( origin + k, SLICE_STEPS, 2, k % 2 ) ] += k + 1.0;
+    fuse_rotate_bins( &bins[ 0 ], &row[ 0 ], origin - SLICE_STEPS, SLICE_STEPS, 2 );
+    bool in_order = true;
+    for ( long k = 0; k < SLICE_STEPS; ++k )
+      in_order = in_order and row[ 2 * k + k % 2 ] == k + 1.0 and row[ 2 * k + 1 - k % 2 ] == 0.0;
+    expect( in_order, "count table: rotation of step bins" );
+    expect( std::count( bins.begin(), bins.end(), 0.0 ) == SLICE_STEPS * 2, "count table: step bins cleared" );
+  }
+}
+
+#ifdef SPIKE_DETECTOR_FUSE_STATS
+void
+test_stats()
+{
+  // Every thread counts the spikes it handles, including those of senders
+  // outside all channels, and the totals add up to the spikes sent
+  const Channel channel = { 1, 1000, 20.0, 100.0, 0.0, 0.0 };
+  emulated_fuse< exponential_kernel > fuse( std::vector< Channel >( 1, channel ), 4 );
+  for ( long s = 0; s < 5; ++s )
+  {
+    for ( long gid = 1; gid <= 1200; ++gid )
+      fuse.handle( gid, gid % SLICE_STEPS );
+    fuse.slice();
+  }
+  expect( fuse.spikes_handled() == 6000, "stats: spikes handled" );
+}
+#endif
+
+void
+test_sampling()
+{
+  // The hash picks close to the requested fraction of consecutive GIDs
+  fuse_gid_sampler sampler;
+  sampler.configure( 0.1, 7, std::vector< long >() );
+  long n_sampled = 0;
+  for ( long gid = 1; gid <= 100000; ++gid )
+    n_sampled += sampler.contains( gid );
+  expect( std::abs( n_sampled - 10000 ) < 500, "sampling: fraction" );
+
+  const long gids[] = { 5, 9, 12 };
+  sampler.configure( 0.1, 7, std::vector< long >( gids, gids + 3 ) );
+  expect( sampler.contains( 5 ) and sampler.contains( 12 ) and not sampler.contains( 6 ), "sampling: explicit GIDs" );
+  expect( not sampler.contains( 4 ) and not sampler.contains( 13 ), "sampling: outside explicit GIDs" );
+
+  sampler.configure( 1.0, 0, std::vector< long >() );
+  expect( sampler.contains( 3 ), "sampling: all" );
+}
+
+void
+test_telemetry()
+{
+  const std::string name = "/sdfuse_core_test_" + std::to_string( getpid() );
+  fuse_telemetry_record record;
+
+  // A segment has a single writer while that writer is alive
+  {
+    FuseTelemetry writer;
+    FuseTelemetry other;
+    expect( writer.open( name, 7, 2 ), "telemetry: open" );
+    expect( not other.open( name, 8, 2 ), "telemetry: second writer" );
+    fuse_telemetry_record* shared = writer.begin_write();
+    shared->slice = 3;
+    writer.end_write();
+    expect( read_fuse_telemetry( shared, record ) == FUSE_TELEMETRY_VALID and record.slice == 3
+        and record.device_gid == 7 and record.n_channels == 2,
+      "telemetry: read" );
+
+    // A writer that stops in the middle of a write leaves a torn record
+    writer.begin_write();
+    expect( read_fuse_telemetry( shared, record, 10 ) == FUSE_TELEMETRY_TORN, "telemetry: torn" );
+    writer.end_write();
+  }
+
+  // A segment left behind by a writer that died is replaced
+  const pid_t child = fork();
+  if ( child == 0 )
+  {
+    FuseTelemetry* writer = new FuseTelemetry();
+    _exit( writer->open( name, 9, 1 ) ? 0 : 1 );
+  }
+  int status = 1;
+  waitpid( child, &status, 0 );
+  FuseTelemetry writer;
+  expect( WIFEXITED( status ) and WEXITSTATUS( status ) == 0, "telemetry: open in child" );
+  expect( writer.open( name, 10, 1 ), "telemetry: replace stale segment" );
+}
+
+/**
+ * Process about n_million million spikes of 100000 neurons in two channels
+ * on 8 emulated threads and report the throughput. Spikes are drawn before
+ * the timed section, one slice at a time. The rate threshold is thresh_factor
+ * times the rate, close enough that the danger level stays well above 0
+ * without tripping, and every slice runs the full trip check.
+ */
+template < typename TKernel >
+void
+benchmark_kernel( const std::string& name, const double n_million, const double thresh_factor )
+{
+  const long n_neurons = 100000;
+  const double rate = 20.0;
+  const double thresh = thresh_factor * rate;
+  const Channel channels[] = { { 1, 80000, thresh, 100.0, 0.25 * rate, 100.0 },
+    { 80001, 100000, thresh, 100.0, 0.25 * rate, 100.0 } };
+  emulated_fuse< TKernel > fuse( std::vector< Channel >( channels, channels + 2 ), 8 );
+
+  std::mt19937 rng( 4711 );
+  std::vector< long > gids, steps;
+  double seconds = 0.0;
+  long n_spikes = 0;
+  long n_slices = 0;
+  long n_trips = 0;
+  while ( n_spikes < n_million * 1e6 )
+  {
+    gids.clear();
+    steps.clear();
+    draw_slice( rng, 1, n_neurons, rate, gids, steps );
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for ( size_t i = 0; i < gids.size(); ++i )
+      fuse.handle( gids[ i ], steps[ i ] );
+    if ( fuse.slice() != fuse_core< TKernel >::NO_TRIP )
+      ++n_trips;
+    seconds += std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+
+    n_spikes += gids.size();
+    ++n_slices;
+  }
+
+  std::printf( "%-12s %10ld spikes %8ld slices %8.2f Mspikes/s %7.2f ns/spike %8.2f us/slice (danger %.3f, %ld trips)\n",
+    name.c_str(),
+    n_spikes,
+    n_slices,
+    n_spikes / seconds * 1e-6,
+    seconds / n_spikes * 1e9,
+    seconds / n_slices * 1e6,
+    fuse.core().max_danger_level()[ 0 ],
+    n_trips );
+}
+
+} // namespace
+
+int
+main( int argc, char* argv[] )
+{
+  if ( argc > 1 and std::strcmp( argv[ 1 ], "--benchmark" ) == 0 )
+  {
+    const double n_million = argc > 2 ? std::atof( argv[ 2 ] ) : 50.0;
+    // The traces settle at a danger level of 0.8. CUSUM forgets all activity
+    // below the threshold, so it is run at the threshold, where it follows
+    // the fluctuations of the rate.
+    benchmark_kernel< exponential_kernel >( "exponential", n_million, 1.25 );
+    benchmark_kernel< boxcar_kernel >( "boxcar", n_million, 1.25 );
+    benchmark_kernel< cusum_kernel >( "cusum", n_million, 1.0 );
+    return 0;
+  }
+
+  test_calibration();
+  test_channels();
+  test_count_table();
+#ifdef SPIKE_DETECTOR_FUSE_STATS
+  test_stats();
+#endif
+  test_sampling();
+  test_telemetry();
+  test_kernel< exponential_kernel >( "exponential" );
+  test_kernel< boxcar_kernel >( "boxcar" );
+  test_kernel< cusum_kernel >( "cusum" );
+  test_prediction< exponential_kernel >( "exponential" );
+  test_prediction< boxcar_kernel >( "boxcar" );
+  test_prediction< cusum_kernel >( "cusum" );
+  test_synchrony< exponential_kernel >( "exponential" );
+
+  if ( n_failures > 0 )
+  {
+    std::printf( "%d test(s) failed\n", n_failures );
+    return 1;
+  }
+  std::printf( "All tests passed\n" );
+  return 0;
+}
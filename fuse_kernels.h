@@ -0,0 +1,337 @@
+/*
+ *  fuse_kernels.h
+ *
+ *  This file is part of NEST.
+ *
+ *  Copyright (C) 2004 The NEST Initiative
+ *
+ *  NEST is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  NEST is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with NEST.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef FUSE_KERNELS_H
+#define FUSE_KERNELS_H
+
+// C++ includes:
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+/* BeginDocumentation
+
+Name: fuse_kernels - Detection statistics of the spike_detector_fuse models
+
+Description:
+
+Each spike_detector_fuse model computes a danger level per channel from the number of spikes
+received per simulation step, normalized such that the fuse trips when it exceeds 1. The
+statistic is a policy class, chosen at compile time for each model:
+
+  spike_detector_fuse         - exponential trace, see spike_detector_fuse
+  spike_detector_fuse_boxcar  - number of spikes in a sliding window of length_thresh, divided
+                                by the number expected at frequency_thresh
+  spike_detector_fuse_cusum   - one-sided CUSUM of the excess of spikes over the number expected
+                                at frequency_thresh, divided by the number expected at
+                                frequency_thresh within length_thresh
+
+The boxcar window is rounded to whole slices (min_delay), so its danger level changes once per
+slice. The CUSUM statistic forgets all activity below frequency_thresh, but accumulates any
+excess, so that a rate of twice the threshold trips it after about length_thresh.
+
+SeeAlso: spike_detector_fuse
+*/
+
+namespace mynest
+{
+
+/**
+ * Calibrate the decay per step and the increment per spike of a danger trace
+ * for n_neurons neurons, given the rate threshold in Hz and length in ms.
+ */
+inline void
+calibrate_trace( const double rate_thresh,
+  const double length_thresh,
+  const double n_neurons,
+  const double step_ms,
+  double& decay_factor,
+  double& increment_step )
+{
+  // Discretizing length in terms of simulation update steps
+  int length_update_steps = std::max( 1, int(length_thresh / step_ms + 0.5) );
+
+  // Calculating decay_factor from the following transient equation describing convergence of danger to maximum /
+  // steady state:
+  //
+  //     decay_factor^length_update_steps = 0.3
+  decay_factor = std::pow(0.3, 1.0/length_update_steps);
+
+  // Calculating scale factor by requiring that the steady state danger for a network spiking at rate_thresh
+  // is 1. The danger is driven by the spike count of all threads, i.e. by the spikes of all connected neurons in
+  // one step
+  //
+  // i.e. (rate_thresh*n_neurons*step_ms*1e-3*increment_step)/(1-decay_factor) = 1
+  increment_step = (1 - decay_factor)/(rate_thresh*n_neurons*step_ms*1e-3);
+}
+
+/**
+ * Detection statistics used as the TKernel policy of
+ * basic_spike_detector_fuse. A kernel provides
+ *
+ * - resize(n_channels): prepare for n_channels channels, keeping the state
+ *   if the number does not change,
+ * - calibrate(c, rate_thresh, length_thresh, n_neurons, step_ms, slice_steps):
+ *   set the constants of channel c, called at every calibration,
+ * - reset(): restart the statistic of all channels,
+ * - offset_decay_rate(c, step_ms): log of the weight of a precise spike per
+ *   ms of offset,
+ * - advance(n_spikes, n_steps, n_channels, danger, max_danger): advance all
+ *   channels over the steps of one slice, given the spike counts laid out as
+ *   [step][channel], writing the danger levels and raising max_danger.
+ *
+ * advance() is called once per slice and inlined into the update of the
+ * detector.
+ */
+
+/**
+ * Exponential danger trace d = d*alpha + n*delta, the statistic of the
+ * original spike_detector_fuse. The trace is its own state, so the danger
+ * levels are continued as they are.
+ */
+class exponential_kernel
+{
+public:
+  void
+  resize( const size_t n_channels )
+  {
+    decay_factor_.assign( n_channels, 0.0 );
+    increment_step_.assign( n_channels, 0.0 );
+  }
+
+  void
+  calibrate( const size_t c,
+    const double rate_thresh,
+    const double length_thresh,
+    const double n_neurons,
+    const double step_ms,
+    const long )
+  {
+    calibrate_trace( rate_thresh, length_thresh, n_neurons, step_ms, decay_factor_[ c ], increment_step_[ c ] );
+  }
+
+  void
+  reset()
+  {
+  }
+
+  double
+  offset_decay_rate( const size_t c, const double step_ms ) const
+  {
+    return std::log( decay_factor_[ c ] ) / step_ms;
+  }
+
+  void
+  advance( const double* n_spikes, const long n_steps, const size_t n_channels, double* danger, double* max_danger )
+  {
+    const double* const decay = &decay_factor_[ 0 ];
+    const double* const increment = &increment_step_[ 0 ];
+
+    // Steps must be processed in order, the channels of a step are
+    // independent and form the inner loop, which the compiler can vectorize
+    for ( long k = 0; k < n_steps; ++k )
+    {
+      const double* const n = n_spikes + k * n_channels;
+      for ( size_t c = 0; c < n_channels; ++c )
+      {
+        danger[ c ] = danger[ c ] * decay[ c ] + increment[ c ] * n[ c ];
+        max_danger[ c ] = max_danger[ c ] < danger[ c ] ? danger[ c ] : max_danger[ c ];
+      }
+    }
+  }
+
+private:
+  std::vector< double > decay_factor_;   //!< decay of the danger trace per step
+  std::vector< double > increment_step_; //!< danger increment per spike
+};
+
+/**
+ * Exact number of spikes in a sliding window of whole slices, kept in a ring
+ * of per-slice counts per channel.
+ */
+class boxcar_kernel
+{
+public:
+  boxcar_kernel()
+    : n_channels_( 0 )
+  {
+  }
+
+  void
+  resize( const size_t n_channels )
+  {
+    // The constants are set again by calibrate(), the state is kept
+    scale_.assign( n_channels, 0.0 );
+    if ( n_channels != n_channels_ )
+    {
+      n_channels_ = n_channels;
+      window_sum_.assign( n_channels, 0.0 );
+      position_.assign( n_channels, 0 );
+      ring_.assign( n_channels, std::vector< double >( 1, 0.0 ) );
+    }
+  }
+
+  void
+  calibrate( const size_t c,
+    const double rate_thresh,
+    const double length_thresh,
+    const double n_neurons,
+    const double step_ms,
+    const long slice_steps )
+  {
+    const size_t window_slices = std::max( 1, int( length_thresh / ( step_ms * slice_steps ) + 0.5 ) );
+    scale_[ c ] = 1.0 / ( rate_thresh * n_neurons * window_slices * slice_steps * step_ms * 1e-3 );
+
+    // A changed window restarts the count of the channel
+    if ( ring_[ c ].size() != window_slices )
+    {
+      ring_[ c ].assign( window_slices, 0.0 );
+      window_sum_[ c ] = 0.0;
+      position_[ c ] = 0;
+    }
+  }
+
+  void
+  reset()
+  {
+    for ( size_t c = 0; c < n_channels_; ++c )
+      std::fill( ring_[ c ].begin(), ring_[ c ].end(), 0.0 );
+    std::fill( window_sum_.begin(), window_sum_.end(), 0.0 );
+    std::fill( position_.begin(), position_.end(), 0 );
+  }
+
+  double
+  offset_decay_rate( const size_t, const double ) const
+  {
+    return 0.0;
+  }
+
+  void
+  advance( const double* n_spikes, const long n_steps, const size_t n_channels, double* danger, double* max_danger )
+  {
+    for ( size_t c = 0; c < n_channels; ++c )
+    {
+      double n_slice = 0.0;
+      for ( long k = 0; k < n_steps; ++k )
+        n_slice += n_spikes[ k * n_channels + c ];
+
+      // Replace the oldest slice of the window
+      std::vector< double >& ring = ring_[ c ];
+      window_sum_[ c ] += n_slice - ring[ position_[ c ] ];
+      ring[ position_[ c ] ] = n_slice;
+      position_[ c ] = ( position_[ c ] + 1 ) % ring.size();
+
+      danger[ c ] = window_sum_[ c ] * scale_[ c ];
+      max_danger[ c ] = max_danger[ c ] < danger[ c ] ? danger[ c ] : max_danger[ c ];
+    }
+  }
+
+private:
+  size_t n_channels_;
+  std::vector< double > scale_;      //!< inverse of the window count at threshold
+  std::vector< double > window_sum_; //!< spikes in the window
+  std::vector< size_t > position_;   //!< oldest slice in the ring
+  std::vector< std::vector< double > > ring_; //!< spikes per slice of the window
+};
+
+/**
+ * One-sided CUSUM change-point statistic s = max(0, s + n - mu), where mu is
+ * the expected number of spikes per step at frequency_thresh, normalized by
+ * the number of spikes expected at frequency_thresh within length_thresh.
+ */
+class cusum_kernel
+{
+public:
+  cusum_kernel()
+    : n_channels_( 0 )
+  {
+  }
+
+  void
+  resize( const size_t n_channels )
+  {
+    // The constants are set again by calibrate(), the state is kept
+    expected_.assign( n_channels, 0.0 );
+    scale_.assign( n_channels, 0.0 );
+    if ( n_channels != n_channels_ )
+    {
+      n_channels_ = n_channels;
+      sum_.assign( n_channels, 0.0 );
+    }
+  }
+
+  void
+  calibrate( const size_t c,
+    const double rate_thresh,
+    const double length_thresh,
+    const double n_neurons,
+    const double step_ms,
+    const long )
+  {
+    const int length_steps = std::max( 1, int( length_thresh / step_ms + 0.5 ) );
+    expected_[ c ] = rate_thresh * n_neurons * step_ms * 1e-3;
+    scale_[ c ] = 1.0 / ( expected_[ c ] * length_steps );
+  }
+
+  void
+  reset()
+  {
+    std::fill( sum_.begin(), sum_.end(), 0.0 );
+  }
+
+  double
+  offset_decay_rate( const size_t, const double ) const
+  {
+    return 0.0;
+  }
+
+  void
+  advance( const double* n_spikes, const long n_steps, const size_t n_channels, double* danger, double* max_danger )
+  {
+    const double* const expected = &expected_[ 0 ];
+    const double* const scale = &scale_[ 0 ];
+    double* const sum = &sum_[ 0 ];
+
+    for ( long k = 0; k < n_steps; ++k )
+    {
+      const double* const n = n_spikes + k * n_channels;
+      for ( size_t c = 0; c < n_channels; ++c )
+      {
+        const double s = sum[ c ] + n[ c ] - expected[ c ];
+        sum[ c ] = s > 0.0 ? s : 0.0;
+        danger[ c ] = sum[ c ] * scale[ c ];
+        max_danger[ c ] = max_danger[ c ] < danger[ c ] ? danger[ c ] : max_danger[ c ];
+      }
+    }
+  }
+
+private:
+  size_t n_channels_;
+  std::vector< double > expected_; //!< spikes per step at frequency_thresh
+  std::vector< double > scale_;    //!< inverse of the spikes expected within length_thresh
+  std::vector< double > sum_;      //!< CUSUM statistic in spikes
+};
+
+} // namespace
+
+#endif /* #ifndef FUSE_KERNELS_H */
@@ -0,0 +1,132 @@
+/*
+ *  fuse_stats.h
+ *
+ *  This file is part of NEST.
+ *
+ *  Copyright (C) 2004 The NEST Initiative
+ *
+ *  NEST is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  NEST is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with NEST.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef FUSE_STATS_H
+#define FUSE_STATS_H
+
+/*
+ * Hot-path instrumentation of the spike_detector_fuse models. It is compiled
+ * in only if SPIKE_DETECTOR_FUSE_STATS is defined, e.g. by configuring with
+ * -Dwith-fuse-stats=ON. Otherwise this header defines nothing and the models
+ * contain no counting code.
+ */
+#ifdef SPIKE_DETECTOR_FUSE_STATS
+
+// C includes:
+#include <stdint.h>
+#include <time.h>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#endif
+
+// Includes from this module:
+#include "misc.h"
+
+namespace mynest
+{
+
+/**
+ * Return a cheap, monotonic cycle count: the time stamp counter on x86, the
+ * virtual counter on AArch64, and nanoseconds elsewhere. Only differences of
+ * counts read on the same thread are meaningful.
+ */
+inline uint64_t
+read_cycle_counter()
+{
+#if defined( __x86_64__ ) || defined( __i386__ )
+  return __rdtsc();
+#elif defined( __aarch64__ )
+  uint64_t count;
+  __asm__ __volatile__( "mrs %0, cntvct_el0" : "=r"( count ) );
+  return count;
+#else
+  timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return static_cast< uint64_t >( ts.tv_sec ) * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/**
+ * Counters of one thread sibling. Every sibling only writes its own counters,
+ * which are padded by a whole cache line on both sides so that they never
+ * share a cache line with data written by another thread, wherever the node
+ * is allocated. They are summed over the siblings by get_status().
+ */
+struct FuseStats
+{
+  char pad_front_[ CACHE_LINE_SIZE ];
+
+  uint64_t spikes_handled;  //!< spikes received by handle(), with multiplicity
+  uint64_t events_buffered; //!< records buffered for update()
+  uint64_t peak_buffered;   //!< largest number of records read by one update()
+  uint64_t bytes_recorded;  //!< bytes of binary output and streamed columns
+  uint64_t handle_cycles;   //!< cycles spent in handle()
+  uint64_t update_cycles;   //!< cycles spent in update()
+
+  char pad_back_[ CACHE_LINE_SIZE ];
+
+  FuseStats()
+  {
+    reset();
+  }
+
+  void
+  reset()
+  {
+    spikes_handled = 0;
+    events_buffered = 0;
+    peak_buffered = 0;
+    bytes_recorded = 0;
+    handle_cycles = 0;
+    update_cycles = 0;
+  }
+};
+
+/**
+ * Adds the cycles between its construction and destruction to a counter,
+ * covering all exits of the enclosing scope.
+ */
+class CycleTimer
+{
+public:
+  explicit CycleTimer( uint64_t& cycles )
+    : cycles_( cycles )
+    , start_( read_cycle_counter() )
+  {
+  }
+
+  ~CycleTimer()
+  {
+    cycles_ += read_cycle_counter() - start_;
+  }
+
+private:
+  uint64_t& cycles_;
+  const uint64_t start_;
+};
+
+} // namespace
+
+#endif /* #ifdef SPIKE_DETECTOR_FUSE_STATS */
+
+#endif /* #ifndef FUSE_STATS_H */
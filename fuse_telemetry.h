@@ -0,0 +1,273 @@
+/*
+ *  fuse_telemetry.h
+ *
+ *  This file is part of NEST.
+ *
+ *  Copyright (C) 2004 The NEST Initiative
+ *
+ *  NEST is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  NEST is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with NEST.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef FUSE_TELEMETRY_H
+#define FUSE_TELEMETRY_H
+
+/*
+ * Live telemetry of the spike_detector_fuse models through POSIX shared
+ * memory. The sibling on thread 0 publishes a record of fixed layout once per
+ * slice, and any local process can map the segment and read the record
+ * without locks and without slowing down the simulation, see
+ * fuse_telemetry_reader.cpp. This header does not depend on NEST.
+ *
+ * The record is protected by a sequence lock: the writer makes the sequence
+ * number odd before and even again after it updates the record, and a reader
+ * retries its copy until it saw the same even sequence number before and
+ * after copying. A segment has a single writer, whose process ID is stored in
+ * the record, so that readers and later writers can tell whether it is still
+ * alive.
+ */
+
+// C includes:
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// C++ includes:
+#include <string>
+
+namespace mynest
+{
+
+//! Channels reported in a telemetry record, further channels are left out
+const uint32_t FUSE_TELEMETRY_CHANNELS = 16;
+
+/**
+ * Layout of the shared memory segment, 64 bit aligned and in native byte
+ * order.
+ */
+struct fuse_telemetry_record
+{
+  char magic[ 8 ]; //!< "SDFTELE" padded with zeros
+  uint32_t version;
+  uint32_t n_channels; //!< valid entries of the per-channel arrays
+  uint64_t sequence;   //!< odd while the record is being written
+  uint64_t device_gid;
+  int64_t slice;    //!< last slice whose spikes were folded into the traces
+  double time;      //!< end of that slice in ms
+  uint32_t fused;   //!< 1 once the fuse tripped
+  uint32_t trip;    //!< reason of the trip, the value of fuse_core::trip
+  int32_t writer_pid; //!< process ID of the writer
+  uint32_t reserved;
+  double danger_level[ FUSE_TELEMETRY_CHANNELS ];
+  double n_spikes[ FUSE_TELEMETRY_CHANNELS ]; //!< spikes of each channel in that slice
+  double rate[ FUSE_TELEMETRY_CHANNELS ];     //!< mean rate per neuron in that slice in Hz
+};
+
+const uint32_t FUSE_TELEMETRY_VERSION = 2;
+
+//! Result of read_fuse_telemetry()
+enum fuse_telemetry_status
+{
+  FUSE_TELEMETRY_VALID,   //!< a consistent copy of a telemetry record
+  FUSE_TELEMETRY_INVALID, //!< the segment does not hold a telemetry record
+  FUSE_TELEMETRY_TORN     //!< the record stayed inconsistent, the writer died while writing
+};
+
+/**
+ * Return true if the process that wrote the record still exists.
+ */
+inline bool
+fuse_telemetry_writer_alive( const fuse_telemetry_record& record )
+{
+  return record.writer_pid > 0 and ( kill( record.writer_pid, 0 ) == 0 or errno == EPERM );
+}
+
+/**
+ * Copy the record in shared memory to copy, retrying while it is written.
+ * A record is written in well below a microsecond, so if it is still
+ * inconsistent after max_retries retries 10 us apart, the writer stopped in
+ * the middle of a write.
+ */
+inline fuse_telemetry_status
+read_fuse_telemetry( const fuse_telemetry_record* shared,
+  fuse_telemetry_record& copy,
+  const unsigned int max_retries = 10000 )
+{
+  for ( unsigned int retry = 0; retry <= max_retries; ++retry )
+  {
+    const uint64_t before = __atomic_load_n( &shared->sequence, __ATOMIC_ACQUIRE );
+    if ( before % 2 == 0 )
+    {
+      memcpy( &copy, shared, sizeof( copy ) );
+      __atomic_thread_fence( __ATOMIC_ACQUIRE );
+      if ( __atomic_load_n( &shared->sequence, __ATOMIC_RELAXED ) == before )
+        return strcmp( copy.magic, "SDFTELE" ) == 0 and copy.version == FUSE_TELEMETRY_VERSION
+          ? FUSE_TELEMETRY_VALID
+          : FUSE_TELEMETRY_INVALID;
+    }
+    usleep( 10 );
+  }
+  return FUSE_TELEMETRY_TORN;
+}
+
+/**
+ * Writer of a telemetry record in a named shared memory segment. The segment
+ * is created by open() and removed by close() or the destructor.
+ */
+class FuseTelemetry
+{
+public:
+  FuseTelemetry()
+    : record_( 0 )
+  {
+  }
+
+  ~FuseTelemetry()
+  {
+    close();
+  }
+
+  /**
+   * Create the segment of the given name, which must start with a slash,
+   * and initialize the record. A segment left behind by a writer that no
+   * longer exists is replaced. Return false if the segment cannot be created
+   * or another writer still uses it.
+   */
+  bool
+  open( const std::string& name, const uint64_t device_gid, const size_t n_channels )
+  {
+    close();
+    int fd = shm_open( name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644 );
+    if ( fd < 0 and errno == EEXIST and not has_live_writer_( name ) )
+    {
+      shm_unlink( name.c_str() );
+      fd = shm_open( name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644 );
+    }
+    if ( fd < 0 )
+      return false;
+    void* memory = MAP_FAILED;
+    if ( ftruncate( fd, sizeof( fuse_telemetry_record ) ) == 0 )
+      memory = mmap( 0, sizeof( fuse_telemetry_record ), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if ( memory == MAP_FAILED )
+    {
+      shm_unlink( name.c_str() );
+      return false;
+    }
+
+    name_ = name;
+    record_ = static_cast< fuse_telemetry_record* >( memory );
+
+    fuse_telemetry_record* record = begin_write();
+    strncpy( record->magic, "SDFTELE", sizeof( record->magic ) );
+    record->version = FUSE_TELEMETRY_VERSION;
+    record->n_channels = n_channels < FUSE_TELEMETRY_CHANNELS ? n_channels : FUSE_TELEMETRY_CHANNELS;
+    record->device_gid = device_gid;
+    record->slice = -1;
+    record->time = 0.0;
+    record->fused = 0;
+    record->trip = 0;
+    record->writer_pid = getpid();
+    memset( record->danger_level, 0, sizeof( record->danger_level ) );
+    memset( record->n_spikes, 0, sizeof( record->n_spikes ) );
+    memset( record->rate, 0, sizeof( record->rate ) );
+    end_write();
+    return true;
+  }
+
+  void
+  close()
+  {
+    if ( record_ == 0 )
+      return;
+    munmap( record_, sizeof( fuse_telemetry_record ) );
+    shm_unlink( name_.c_str() );
+    record_ = 0;
+    name_.clear();
+  }
+
+  bool
+  is_open() const
+  {
+    return record_ != 0;
+  }
+
+  const std::string&
+  name() const
+  {
+    return name_;
+  }
+
+  /**
+   * Mark the record as being written and return it. Every call must be
+   * followed by end_write().
+   */
+  fuse_telemetry_record*
+  begin_write()
+  {
+    __atomic_store_n( &record_->sequence, record_->sequence + 1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+    return record_;
+  }
+
+  void
+  end_write()
+  {
+    __atomic_store_n( &record_->sequence, record_->sequence + 1, __ATOMIC_RELEASE );
+  }
+
+private:
+  FuseTelemetry( const FuseTelemetry& );
+  FuseTelemetry& operator=( const FuseTelemetry& );
+
+  /**
+   * Return true unless the existing segment of the given name is a telemetry
+   * segment whose writer no longer exists. Segments of other programs are
+   * never replaced.
+   */
+  static bool
+  has_live_writer_( const std::string& name )
+  {
+    const int fd = shm_open( name.c_str(), O_RDONLY, 0 );
+    if ( fd < 0 )
+      return errno != ENOENT;
+    struct stat status;
+    void* memory = MAP_FAILED;
+    if ( fstat( fd, &status ) == 0 and status.st_size == sizeof( fuse_telemetry_record ) )
+      memory = mmap( 0, sizeof( fuse_telemetry_record ), PROT_READ, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if ( memory == MAP_FAILED )
+      return true;
+
+    // The magic and the writer are not changed after the segment is created
+    const fuse_telemetry_record* record = static_cast< const fuse_telemetry_record* >( memory );
+    bool alive = true;
+    if ( strncmp( record->magic, "SDFTELE", sizeof( record->magic ) ) == 0 )
+      alive = record->version == FUSE_TELEMETRY_VERSION and fuse_telemetry_writer_alive( *record );
+    munmap( memory, sizeof( fuse_telemetry_record ) );
+    return alive;
+  }
+
+  fuse_telemetry_record* record_;
+  std::string name_;
+};
+
+} // namespace
+
+#endif /* #ifndef FUSE_TELEMETRY_H */
@@ -0,0 +1,137 @@
+/*
+ *  fuse_telemetry_reader.cpp
+ *
+ *  This file is part of NEST.
+ *
+ *  Copyright (C) 2004 The NEST Initiative
+ *
+ *  NEST is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  NEST is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with NEST.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Print the telemetry that a spike_detector_fuse publishes with
+ * telemetry_name set, without locks and without NEST.
+ *
+ *   fuse_telemetry_reader NAME [INTERVAL_MS]
+ *
+ * prints one line per new record every INTERVAL_MS (default 500) until the
+ * fuse trips or the segment is removed, or a single line if INTERVAL_MS is 0.
+ * It exits with status 1 if the writer died and left the record stale or in
+ * the middle of a write.
+ */
+
+// C includes:
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// C++ includes:
+#include <cstdio>
+#include <cstdlib>
+
+// Includes from this module:
+#include "fuse_telemetry.h"
+
+using namespace mynest;
+
+namespace
+{
+
+const char* const TRIP_NAMES[] = { "", "UnstableSpiking", "QuiescentNetwork", "SynchronousSpiking",
+  "PredictedUnstableSpiking" };
+
+void
+print_record( const fuse_telemetry_record& record )
+{
+  std::printf( "gid %llu  slice %lld  t %10.1f ms", static_cast< unsigned long long >( record.device_gid ),
+    static_cast< long long >( record.slice ), record.time );
+  for ( uint32_t c = 0; c < record.n_channels; ++c )
+    std::printf( "  [%u] danger %.3f rate %.1f Hz", c, record.danger_level[ c ], record.rate[ c ] );
+  if ( record.fused )
+    std::printf( "  TRIPPED %s", record.trip < 5 ? TRIP_NAMES[ record.trip ] : "" );
+  std::printf( "\n" );
+  std::fflush( stdout );
+}
+
+} // namespace
+
+int
+main( int argc, char* argv[] )
+{
+  if ( argc < 2 )
+  {
+    std::fprintf( stderr, "usage: %s NAME [INTERVAL_MS]\n", argv[ 0 ] );
+    return 2;
+  }
+  const long interval_ms = argc > 2 ? std::atol( argv[ 2 ] ) : 500;
+
+  const int fd = shm_open( argv[ 1 ], O_RDONLY, 0 );
+  if ( fd < 0 )
+  {
+    std::perror( argv[ 1 ] );
+    return 1;
+  }
+  void* memory = mmap( 0, sizeof( fuse_telemetry_record ), PROT_READ, MAP_SHARED, fd, 0 );
+  close( fd );
+  if ( memory == MAP_FAILED )
+  {
+    std::perror( argv[ 1 ] );
+    return 1;
+  }
+  const fuse_telemetry_record* shared = static_cast< const fuse_telemetry_record* >( memory );
+
+  fuse_telemetry_record record;
+  uint64_t last_sequence = 1;
+  int exit_status = 1;
+  while ( true )
+  {
+    const fuse_telemetry_status status = read_fuse_telemetry( shared, record );
+    if ( status == FUSE_TELEMETRY_INVALID )
+    {
+      std::fprintf( stderr, "%s does not hold spike_detector_fuse telemetry\n", argv[ 1 ] );
+      break;
+    }
+    if ( status == FUSE_TELEMETRY_TORN )
+    {
+      std::fprintf( stderr, "%s is torn, its writer stopped in the middle of a write\n", argv[ 1 ] );
+      break;
+    }
+    if ( record.sequence != last_sequence )
+    {
+      print_record( record );
+      last_sequence = record.sequence;
+    }
+
+    // The writer removes the segment when the device is destroyed, the
+    // mapping stays valid but is no longer updated
+    const int check = shm_open( argv[ 1 ], O_RDONLY, 0 );
+    if ( check >= 0 )
+      close( check );
+    if ( interval_ms <= 0 or record.fused or check < 0 )
+    {
+      exit_status = 0;
+      break;
+    }
+    if ( not fuse_telemetry_writer_alive( record ) )
+    {
+      std::fprintf( stderr, "%s is stale, its writer %d no longer exists\n", argv[ 1 ], record.writer_pid );
+      break;
+    }
+    usleep( interval_ms * 1000 );
+  }
+
+  munmap( memory, sizeof( fuse_telemetry_record ) );
+  return exit_status;
+}
@@ -1,9 +1,53 @@
 #ifndef MISC_H
 #define MISC_H
 
+#include <stdlib.h>
+
+#include <cstddef>
+#include <new>
 #include <sstream>
 #include <string>
 
+// Size of a cache line in bytes, used to pad data written by different threads
+const size_t CACHE_LINE_SIZE = 64;
+
+// Allocator that starts every allocation on a cache line, so that data padded
+// to whole cache lines does not share them with other data
+template <typename T>
+struct cache_aligned_allocator
+{
+  typedef T value_type;
+
+  cache_aligned_allocator() {}
+  template <typename U>
+  cache_aligned_allocator( const cache_aligned_allocator<U>& ) {}
+
+  T* allocate( std::size_t n )
+  {
+    void* memory = 0;
+    if ( posix_memalign( &memory, CACHE_LINE_SIZE, n * sizeof( T ) ) != 0 )
+      throw std::bad_alloc();
+    return static_cast<T*>( memory );
+  }
+
+  void deallocate( T* memory, std::size_t )
+  {
+    free( memory );
+  }
+};
+
+template <typename T, typename U>
+bool operator==( const cache_aligned_allocator<T>&, const cache_aligned_allocator<U>& )
+{
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=( const cache_aligned_allocator<T>&, const cache_aligned_allocator<U>& )
+{
+  return false;
+}
+
 template <typename T>
 std::string numberToString ( T Number )
 {
@@ -24,7 +24,15 @@
 #define SPIKE_DETECTOR_FUSE_H
 
 
+// C includes:
+#include <signal.h>
+#include <stdint.h>
+
 // C++ includes:
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <string>
 #include <vector>
 
 // Includes from nestkernel:
@@ -34,6 +42,18 @@
 #include "node.h"
 #include "recording_device.h"
 
+// Includes from this module:
+#include "fuse_core.h"
+#include "fuse_stats.h"
+#include "fuse_telemetry.h"
+
+// Includes from sli:
+#include "doublevectordatum.h"
+#include "intvectordatum.h"
+
+// Misc includes
+#include "misc.h"
+
 /* BeginDocumentation
 
 Name: spike_detector_fuse - Device for detecting single spikes, In addition, it also
@@ -67,7 +87,8 @@ simulation time will not be recorded. Setting the /stop parameter to at the
 latest one min_delay period before the end of the simulation time ensures that
 all spikes desired to be recorded, are recorded.
 
- Spike are not necessarily written to file in chronological order.
+ Spike are not necessarily written to file in chronological order, unless
+ ordered_output is set, see binary output below.
 
 This portion is for the "fuse" portion of the documentation.
 
@@ -78,28 +99,307 @@ There are 3 important parameters for the spike_detector_fuse:
                     [full dynamics explained below]
 3.  n_connected_neurons - Number of neurons connected to the spike_detector_fuse
 
+A single device can guard several populations separately by defining channels (see below).
+
+In addition, the boolean parameter count_only (default false) turns the device into a pure
+fuse. In this mode the received spikes are only counted, nothing is buffered or passed on to
+the recording device, and no events are recorded.
+
 The algorithm calculates a "danger trace" as follows:
 
- d[i+1] = d[i]*alpha + n_spikes_in_current_slice*delta
+ d[i+1] = d[i]*alpha + n_spikes_in_step_i*delta
+
+The danger trace is resolved per simulation step: every spike is binned by its time stamp into
+the step in which it was emitted. Spikes with precise times are weighted by alpha^(offset/h),
+i.e. by the exact decay from the spike time to the end of its step. The weight only enters the
+danger trace: the quiescence and synchrony traces, the prediction, the history and the telemetry
+count every spike as one, since precise spikes are binned twice, once by weight and once by
+count. The trace is nevertheless advanced only once per slice (min_delay), by running the
+recurrence above over the steps of the previous slice in one go.
+
+The spike count n_spikes_in_step_i is the total over all threads: every thread sibling writes
+the per-step counts it received into its own row of a table shared by all siblings. At the start
+of the next slice, the first sibling to get there sums this table once and publishes the result,
+which all siblings read. All siblings therefore compute the same network-wide danger trace and
+take the same decision, independent of how the connected neurons are distributed over the
+threads.
 
-NOTE that the updating of danger is done once per slice and not once per step
+When running with several MPI processes, the sibling on thread 0 of each process additionally
+sums the per-process counts over all processes once per slice, with an allreduce of its own,
+since a device cannot add data to the spike exchange of the kernel. The result is published to
+all siblings of the process and used one slice later, so that every sibling on every rank
+updates the danger trace with the same global count and all ranks abort in the same slice. With
+MPI the fuse therefore trips one slice later than in a single process: fused_at is one
+min_delay after the end of the slice in which the danger level crossed 1. The history keeps the
+end of the slice the counts belong to, as in a single process.
 
 The parameters alpha and delta are calculated as follows:
 
 1.  A consistent firing of rate 'frequency_thresh' converges to a steady state danger level of 1
-2.  A consistent firing of rate 'frequency_thresh' converges to 0.99 in length_thresh time
-3.  The parameter n_connected_neurons must be specified from the user as NEST does not make this
-    information available to the Node. This parameter is required to calculate the frequency of
-    firing of individual neurons
+2.  A consistent firing of rate 'frequency_thresh' converges to 0.99 in length_thresh time,
+    which is rounded to a whole number of simulation steps
+3.  The number of neurons is required to calculate the frequency of firing of individual neurons.
+    Every sibling records the distinct senders connected to it. Their number is summed over all
+    threads and processes together with the spike counts, and alpha and delta are calibrated
+    from this total before the first slice is evaluated and whenever it changes. A non-zero
+    n_connected_neurons (default 0) overrides the count. The count is available as
+    n_connected_senders.
+
+If the value of the "Danger Trace" exceeds 1 in any step, an UnstableSpiking exception is thrown
+by all thread siblings in the following slice and the simulation is aborted. Once the simulation
+is aborted in this manner, it can no longer be resumed, see fuse_action 'stop' below. The data
+for the simulation on the last run may be inconsistent in the sense that some neurons may not
+have run their update function for the slice, but the spike data for that slice will be stored.
+
+Channels:
+
+The parameter channels takes a list of dictionaries, one per channel, with the entries
+
+  name                - Name of the channel, reported when the channel trips
+  gid_ranges          - Flat list of pairs of first and last GID (inclusive) guarded by the
+                        channel, e.g. [1, 800, 1001, 1200]
+  frequency_thresh    - as above, defaults to the frequency_thresh of the device
+  length_thresh       - as above, defaults to the length_thresh of the device
+  quiescence_thresh   - see below, defaults to the quiescence_thresh of the device
+  quiescence_length   - see below, defaults to the quiescence_length of the device
+  n_connected_neurons - as above, defaults to the number of connected senders in gid_ranges
+
+Each channel has its own danger trace, computed from the spikes of the senders in its GID
+ranges only. The ranges of different channels must not overlap, and spikes from senders outside
+all ranges are recorded but do not contribute to any danger trace. If no channels are given, a
+single channel covering all senders with the parameters of the device is used. All channel
+traces are advanced together, channel by channel within each step, and the exception message
+names the channel that tripped. The current danger levels are available as danger_level.
+
+Predictive trip:
+
+In explosive regimes the danger level grows roughly exponentially for many slices before it
+crosses 1. If predict_horizon (in ms, default 0 = disabled) is set, the log of the rate of each
+channel relative to frequency_thresh is fitted by a straight line over time after every slice,
+weighting the slices exponentially with the time constant predict_window (in ms, default 20).
+Only rates of at least predict_min_level (default 0.1) times the threshold are fitted, and the
+fit restarts whenever the rate falls below. Once the fit covers at least 5 slices, has a positive
+slope and explains at least the fraction predict_r_squared (default 0.95) of the variance, the
+danger level is extrapolated from its current value with the fitted growth rate. The rate is
+fitted instead of the danger level, as the danger level also rises while it settles to a
+constant rate. If the extrapolated danger level crosses 1 within predict_horizon,
+UnstableSpiking is thrown as if the threshold had been exceeded, with the predicted time and
+the horizon in the message. The predicted times per channel are available as
+time_to_threshold (infinite if no crossing is predicted).
+
+Quiescence:
+
+Networks whose activity dies out can be terminated as well. If quiescence_thresh (in Hz) and
+quiescence_length (in ms) are both non-zero, a second trace is computed per channel with the
+same recurrence and calibration as the danger trace, using quiescence_thresh and
+quiescence_length in place of frequency_thresh and length_thresh. The trace starts at 1, and if
+it stays below 1, i.e. the smoothed population rate stays below quiescence_thresh, for
+quiescence_length, a QuiescentNetwork exception is thrown in the same way as UnstableSpiking.
+Both parameters can also be given per channel.
+
+Synchrony:
+
+Synchronous bursts are as expensive to simulate as high rates, because of the peaks in spike
+delivery, but need not raise the mean rate. If synchrony_thresh (default 0 = disabled) is set,
+the mean and variance of the spike count per step are tracked per channel, weighting the steps
+exponentially with the time constant synchrony_window (in ms, default 100). If their ratio, the
+Fano factor, stays above synchrony_thresh for synchrony_length (in ms, default 100), a
+SynchronousSpiking exception is thrown in the same way as UnstableSpiking. Independently
+firing neurons have a Fano factor of about 1, while bursts in which every neuron of a channel
+fires once raise it to about the number of neurons in a burst. The current Fano factors are
+available as fano_factor, and the highest count per step in the last slice divided by the
+mean count as peak_to_mean.
+
+Runaway neurons:
+
+The population traces above can miss a small group of neurons firing at very high rates. If
+neuron_rate_thresh (in Hz, default 0 = disabled) is set, the device additionally keeps a danger
+trace per sender, with the same dynamics as above for a single neuron with the thresholds
+neuron_rate_thresh and neuron_length_thresh (in ms, defaults to length_thresh if 0). Only senders
+that actually spike get an entry in a table of 12 bytes per slot, which is allocated for all
+connected senders before the simulation starts, and their traces are decayed lazily when they
+spike again.
+When a sender's trace exceeds 1, the action given by neuron_action is taken:
+
+  "trip"   - all siblings throw UnstableSpiking in the following slice (default)
+  "report" - the GID of the sender is added to runaway_senders
+
+In both cases, n_runaway_senders counts the senders that crossed the threshold on all processes.
+
+Soft stop:
+
+By default (fuse_action 'abort'), tripping the fuse throws one of the exceptions above. With
+fuse_action 'stop', no exception is thrown. Instead, the sibling on thread 0 raises the signal
+flag that the simulation loop checks at the end of every slice, as for an interrupt by the user,
+so that Simulate returns normally at the end of the slice in which the fuse trips, with all nodes
+updated up to the same time. The flag is cleared again by finalize(), and the kernel can simulate
+further without a reset. The device then reports
+
+  fused       - true once the fuse has tripped
+  fused_at    - start of the slice in which it tripped, in ms
+  fuse_reason - the message of the exception that would have been thrown
+
+While fused, the device keeps recording but does not stop the simulation again. Setting fused to
+false rearms it and restarts all traces, including the per-sender traces, e.g. after the
+parameters of the network have been changed. As after an interrupt by the user, the kernel adds
+the time that the stopped call did not simulate to the next call to Simulate.
+
+Flight recorder:
+
+If flight_recorder_length (in ms, default 0 = disabled) is set, every sibling keeps the spikes it
+received during at least the last flight_recorder_length ms in memory, also in count_only mode.
+Memory is organized as one segment per slice, which is reused once it has become older than
+flight_recorder_length, so no allocation takes place in the steady state. When the fuse trips,
+before the exception is thrown or fused is set, and whenever dump_flight_recorder is set to
+true, every sibling writes its spikes to the binary file
+
+  <data_path>/<data_prefix>spike_detector_fuse-<gid>-<vp>.flight
 
-If the value of the "Danger Trace" exceeds 1, an UnstableSpiking exception is thrown and the
-simulation is aborted. Once the simulation is aborted in this manner, it can no longer be resumed.
-The data for the simulation on the last run may be inconsistent in the sense that some neurons may
-not have run their update function for the slice, but the spike data for that slice will be stored.
+An existing file is only replaced if overwrite_files is set in the kernel, otherwise an error is
+logged and the spikes are not written.
+
+The file starts with a 40 byte header (magic "SDFUSE", format version, record size, GID of the
+device, virtual process, number of records), followed by one record of a 64 bit sender GID and
+a 64 bit floating point spike time in ms per spike, in native byte order. Records are ordered by
+the slice in which they were delivered.
+
+Binary output:
+
+If binary_output is true, recorded spikes are not passed to the recording device, and thus are
+neither formatted as text nor counted in n_events. Instead, every sibling collects them in a 1 MiB
+buffer and writes it in one go to the file
+
+  <data_path>/<data_prefix>spike_detector_fuse-<gid>-<vp>.spikes
+
+whenever it is full and at the end of every call to Simulate. The file is opened on the first
+call to Simulate and stays open until the device is destroyed. As for other recording devices,
+an existing file is only replaced if overwrite_files is set in the kernel. The file has the same
+layout as the flight recorder files, and the number of records in the header is updated with
+every write. Both can be mapped into memory with spike_detector_fuse_reader.py. The records are
+interleaved instead of being stored as a column of GIDs and a column of times, so that any
+prefix of the records is a valid file and a buffer is appended with a single write. Whole-file
+columns would need the final number of records before the first time is written, and columns
+per written buffer are not contiguous over the file either. In exchange, a mapped column is a
+view with a stride of 16 bytes, and a pass over one column also reads the other.
+
+If ordered_output is also true, the spikes of all threads of a process are written to a single
+file in the order of their times, with ties ordered by sender GID, so that the file does not need
+to be sorted. Every sibling sorts the spikes it records in each slice. In the following slice,
+when all threads have finished, the sibling on thread 0 merges the sorted runs of all siblings
+into the file of its virtual process, which is the rank of the process; the other siblings write
+no file. The spikes of the last slice are merged by finalize() once all siblings have finished
+the call to Simulate. The contents of the file do not depend on the number of threads.
+
+Streaming:
+
+Retrieving the events of the recording device copies all events recorded so far. If
+stream_events is true, recorded spikes are instead appended to per-thread columns of sender GIDs
+and spike times, and the thread 0 sibling reports in stream one dictionary per thread with the
+entries senders, times and vp, holding the events of that thread not consumed yet. The columns
+are handed out as they are, without copying them. Setting stream_consumed to an array with one
+count per entry of stream drops that many events from the front of the columns of each thread;
+events recorded after the columns were read are kept. The remaining events are moved to new
+columns, so columns handed out before are not modified. Unless release_consumed is true, the new
+columns reserve the capacity of the old ones. Like binary_output, stream_events bypasses the
+recording device, which stores nothing; both can be combined. PyNEST converts the columns to
+arrays of its own, so from Python each poll still copies the events once.
+
+Population histogram:
+
+Most analyses only need binned population rates. If psth_bin (in ms, default 0 = disabled) is
+set, it is rounded to whole steps (at least one), and every sibling counts the spikes it receives
+per bin and channel, from time 0 on. If stop is set, the array of counts is allocated once for
+the whole recording when the simulation starts. Otherwise it grows with the simulated time, by
+doubling in update(), so that it is rarely reallocated. get_status() on thread 0 sums the arrays
+of all siblings into the dictionary psth with the entries
+
+  times  - start of each bin in ms, a bin holds the spikes of the steps ending after its start
+  counts - number of spikes per bin and channel, [bin][channel]
+
+Spikes are counted with their multiplicity, also if count_only is set, so that count_only and
+psth_bin together keep memory proportional to the number of bins rather than spikes. Senders
+outside all channels are not counted. Changing psth_bin or the channels restarts the histogram.
+
+Sampling:
+
+Often only the spikes of a representative subset of the neurons are needed. If sample_fraction
+(default 1) is below 1, only the spikes of that fraction of the senders are recorded. Senders are
+chosen by a hash of their GID and sample_seed (default 0), so the same senders are recorded for
+any number of threads and processes. Alternatively, sample_gids takes the GIDs of the senders to
+record, which takes precedence over sample_fraction. All spikes are still counted by the fuse and
+kept by the flight recorder.
+
+Load shedding:
+
+To keep recording from stalling a simulation through bursts of activity, recording can be reduced
+as the danger level rises. shedding_levels takes an increasing list of danger levels, e.g.
+[0.5, 0.8]. Once the highest danger level of all channels reaches the k-th level, the device
+switches to tier k. In the highest tier, spikes are only counted as with count_only, and in every
+tier k below it only every (shedding_decimation^k)-th spike is recorded (shedding_decimation
+defaults to 10). The device returns to a lower tier once the danger level falls below the level
+of the tier minus shedding_hysteresis (default 0.1). The danger traces and the flight recorder
+are not affected. Tiers are switched at the start of a slice, in the same slice on all threads
+and processes, and apply to the spikes recorded from then on. Every switch is logged, the
+current tier is available as shedding_tier, and the sibling on thread 0 reports all switches as
+the dictionary shedding_timeline with the entries times (in ms) and tiers.
+
+Danger history:
+
+To choose thresholds from a single run, the danger traces can be kept over time. If
+history_interval (in ms, default 0 = disabled) is set, it is rounded down to whole slices (at
+least one), and for every interval the highest danger level at the end of its slices and the
+number of spikes received in it are stored per channel in a ring of history_size entries
+(default 1000). Older entries are overwritten. As the traces and counts are the network-wide
+values, the ring is kept by the sibling on thread 0 only, which reports it as the dictionary
+history with the entries
+
+  times        - end of each interval in ms
+  danger_level - highest danger level per interval and channel, [entry][channel]
+  n_spikes     - number of spikes per interval and channel, [entry][channel]
+
+oldest entry first. With several MPI processes, the counts of a slice are only available one slice
+later, and the entries are still labeled with the end of the interval the counts belong to.
+
+Detection kernels:
+
+The danger level described above is that of the model spike_detector_fuse. The models
+spike_detector_fuse_boxcar and spike_detector_fuse_cusum compute it with a sliding-window count
+and a CUSUM change-point statistic instead, with the same parameters and the same
+normalization to 1 at the threshold, see fuse_kernels.
+
+Telemetry:
+
+Long runs can be watched from another process without calling GetStatus. If telemetry_name is
+set to the name of a POSIX shared memory segment, e.g. "/sdfuse", the sibling on thread 0 of
+the first MPI process creates the segment and publishes a record of fixed layout in it once per
+slice: the slice and time, the danger level, spike count and mean rate per neuron of up to 16
+channels, and whether and why the fuse tripped. The record is written under a sequence lock, so
+readers copy it without locks and without affecting the simulation. The layout is defined in
+fuse_telemetry.h, and fuse_telemetry_reader prints the record of a running simulation. A segment
+has a single writer: Simulate fails with an IOError while another live process or device writes
+to the segment, and a segment left behind by a crashed writer is replaced. The segment is
+removed when the device is destroyed or telemetry_name is cleared.
+
+Instrumentation:
+
+If the module is configured with -Dwith-fuse-stats=ON, every sibling counts its work in the hot
+path, and the sibling on thread 0 reports the totals over all threads as the dictionary stats with
+the entries
+
+  spikes_handled  - spikes received by handle(), counting multiplicity
+  events_buffered - records buffered by handle() for recording in update()
+  peak_buffered   - largest number of records read by a single update() on any thread
+  bytes_recorded  - bytes appended to binary output buffers and streamed columns
+  handle_cycles   - cycles spent in handle(), summed over threads
+  update_cycles   - cycles spent in update(), summed over threads
+
+Cycles are read from the time stamp counter where available, otherwise they are nanoseconds.
+Setting reset_stats to true clears the counters. Without the option, the counters are not
+compiled in and stats is not reported.
 
 Receives: nest::SpikeEvent
 
-SeeAlso: spike_detector, Device, nest::RecordingDevice
+SeeAlso: spike_detector, fuse_kernels, Device, nest::RecordingDevice
 */
 
 
@@ -114,8 +414,9 @@ namespace mynest
 class UnstableSpiking : public nest::KernelException
 {
 public:
-  UnstableSpiking()
+  UnstableSpiking( const std::string& detail = "" )
       : nest::KernelException( "UnstableSpiking" )
+      , detail_( detail )
   {
   }
   ~UnstableSpiking() throw()
@@ -123,11 +424,66 @@ public:
   }
 
   std::string message() const;
+
+private:
+  std::string detail_; //!< what tripped the fuse, e.g. the channel
+};
+
+/**
+ * Exception thrown if the spiking activity of the network stays below the
+ * quiescence threshold for too long.
+ * @ingroup nest::KernelExceptions
+ */
+class QuiescentNetwork : public nest::KernelException
+{
+public:
+  QuiescentNetwork( const std::string& detail = "" )
+      : nest::KernelException( "QuiescentNetwork" )
+      , detail_( detail )
+  {
+  }
+  ~QuiescentNetwork() throw()
+  {
+  }
+
+  std::string message() const;
+
+private:
+  std::string detail_; //!< which channel became quiescent
+};
+
+/**
+ * Exception thrown if the spike counts per step of the network stay too
+ * irregular, i.e. the network fires in synchronous bursts.
+ * @ingroup nest::KernelExceptions
+ */
+class SynchronousSpiking : public nest::KernelException
+{
+public:
+  SynchronousSpiking( const std::string& detail = "" )
+      : nest::KernelException( "SynchronousSpiking" )
+      , detail_( detail )
+  {
+  }
+  ~SynchronousSpiking() throw()
+  {
+  }
+
+  std::string message() const;
+
+private:
+  std::string detail_; //!< which channel fires synchronously
 };
 
 /**
  * Spike detector class with checks to detect unstable spiking.
  *
+ * The statistic compared to the threshold is computed by the policy class
+ * TKernel, see fuse_kernels.h. Each instantiation is registered as a model
+ * of its own, so that the per-slice update is specialized at compile time.
+ * The traces and the trip decision are kept in a fuse_core, which does not
+ * depend on the NEST kernel, see fuse_core.h.
+ *
  * This class manages spike recording for normal and precise spikes. It
  * receives spikes via its handle(nest::SpikeEvent&) method, buffers them, and
  * stores them via its nest::RecordingDevice in the update() method.
@@ -149,12 +505,13 @@ public:
  *
  * @ingroup Devices
  */
-class spike_detector_fuse : public nest::Node
+template < typename TKernel >
+class basic_spike_detector_fuse : public nest::Node
 {
 
 public:
-  spike_detector_fuse();
-  spike_detector_fuse( const spike_detector_fuse& );
+  basic_spike_detector_fuse();
+  basic_spike_detector_fuse( const basic_spike_detector_fuse& );
 
   void set_has_proxies( const bool hp );
   bool
@@ -196,6 +553,130 @@ private:
   void init_state_( nest::Node const& );
   void init_buffers_();
   void calibrate();
+
+  /**
+   * Return the row of the shared count table of this sibling for the given
+   * slice.
+   */
+  double* thread_row_( const long slice );
+
+  /**
+   * Sum the per-step spike counts of all threads of this process in the
+   * given slice into B_.step_sum_.
+   */
+  void sum_thread_counts_( const long slice );
+
+  /**
+   * Return the per-step spike counts of all threads of this process in the
+   * given slice. The first sibling to ask sums the table and publishes the
+   * sums in the global counts of the sibling on thread 0, the others read
+   * them from there. Only used with a single MPI process.
+   */
+  const std::vector< double >& reduce_thread_counts_( const long slice );
+
+  /**
+   * Calibrate the traces of channel c for the given number of neurons.
+   */
+  void calibrate_channel_( const size_t c, const double n_neurons );
+
+  /**
+   * Advance the danger and quiescence traces of all channels over the steps
+   * of one slice, given the number of spikes received by all thread siblings
+   * (on all processes) per step and channel.
+   */
+  void update_danger_( const std::vector< double >& n_spikes );
+
+  typedef fuse_core< TKernel > Core_;
+
+  /**
+   * Check the traces after they have been advanced and return whether and
+   * why the fuse trips. detail describes the channel or senders that tripped
+   * it, as used in the exception messages.
+   */
+  typename Core_::trip check_fuse_( std::string& detail ) const;
+
+  /**
+   * Return the name of a binary file of this sibling with the given
+   * extension, in the data path of the kernel.
+   */
+  std::string build_filename_( const std::string& extension ) const;
+
+  /**
+   * Return false and log an error if the file exists and the kernel does not
+   * allow to overwrite files, see overwrite_files.
+   */
+  bool may_write_file_( const std::string& filename ) const;
+
+  /**
+   * Open the binary output file of this sibling and write its header.
+   */
+  void open_binary_file_();
+
+  /**
+   * Write the buffered binary records and update the number of records in
+   * the file header.
+   */
+  void write_binary_records_();
+
+  /**
+   * Merge the sorted runs of ordered records of the given slice parity of
+   * all siblings into the binary output of this sibling, which must be the
+   * sibling on thread 0, and clear them.
+   */
+  void merge_ordered_records_( const long parity );
+
+  /**
+   * Count this sibling as finished with the call to Simulate, and if it is
+   * the last one, merge the remaining ordered records of all siblings and
+   * write the binary output of the sibling on thread 0. No other sibling
+   * touches that output.
+   */
+  void finalize_ordered_output_();
+
+  /**
+   * Write the contents of the flight recorder of this sibling to its own
+   * binary file, oldest spikes first.
+   */
+  void dump_flight_recorder_() const;
+
+  /**
+   * Switch the recording to the tier of the current danger level, see load
+   * shedding.
+   */
+  void update_shedding_tier_( nest::Time const& Now );
+
+  /**
+   * Extend the population histogram to cover all spikes emitted before the
+   * given step, at least doubling its size.
+   */
+  void grow_psth_( const long steps );
+
+  /**
+   * Publish the traces after a slice, which ended at slice_end, and the
+   * spikes counted in it to the telemetry segment. Only called on the sibling
+   * on thread 0 of the first process.
+   */
+  void publish_telemetry_( nest::Time const& slice_end, const long slice, const std::vector< double >& n_spikes );
+
+  /**
+   * Add the traces after a slice, which ended at slice_end, and the spikes
+   * counted in it to the current history interval, and store the interval
+   * once it is complete. Only called on the sibling on thread 0.
+   */
+  void record_history_( nest::Time const& slice_end, const std::vector< double >& n_spikes );
+
+  /**
+   * Return the channel guarding the given sender, or V_.n_channels if the
+   * sender is not in any channel.
+   */
+  size_t channel_of_( const nest::index sender_gid ) const;
+
+  /**
+   * Update the trace of the sender of the given spike and return true if it
+   * crossed neuron_rate_thresh for the first time.
+   */
+  bool update_sender_trace_( const nest::index sender_gid, const long step, const int multiplicity );
+
   void finalize();
 
   /**
@@ -209,13 +690,150 @@ private:
    */
   void update( nest::Time const&, const long, const long );
 
+  /**
+   * Compact record of a received spike.
+   *
+   * Only the fields the nest::RecordingDevice needs are kept; update()
+   * rebuilds a single stack-allocated nest::SpikeEvent from them. The
+   * multiplicity is stored once instead of storing one record per spike.
+   */
+  struct SpikeRecord_
+  {
+    nest::index sender_gid;
+    long stamp; //!< time stamp in steps
+    double offset;
+    double weight;
+    int port;
+    int multiplicity;
+  };
+
+  /**
+   * Drop all but every decimation-th spike from the given records, counting
+   * spikes over successive slices.
+   */
+  void decimate_records_( std::vector< SpikeRecord_ >& spikes, const long decimation );
+
+  /**
+   * Spike as kept by the flight recorder and written to binary files: the
+   * GID of the sender and the spike time in ms, 16 bytes without padding.
+   */
+  struct FlightRecord_
+  {
+    uint64_t sender_gid;
+    double time;
+
+    //! Order of ordered_output, by time and then by sender
+    bool operator<( const FlightRecord_& other ) const
+    {
+      return time < other.time or ( time == other.time and sender_gid < other.sender_gid );
+    }
+  };
+
+  /**
+   * Remaining records of a sorted run during the merge of ordered records.
+   * Runs compare by their next record in reverse, so that a heap of runs
+   * has the earliest record on top.
+   */
+  struct OrderedRun_
+  {
+    const FlightRecord_* next;
+    const FlightRecord_* end;
+
+    bool operator<( const OrderedRun_& other ) const
+    {
+      return *other.next < *next;
+    }
+  };
+
+  /**
+   * Header of binary files, followed by n_records records of record_size
+   * bytes. The layout is fixed to 40 bytes in native byte order.
+   */
+  struct FileHeader_
+  {
+    char magic[ 8 ]; //!< "SDFUSE" padded with zeros
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t device_gid;
+    uint32_t vp;
+    uint32_t reserved;
+    uint64_t n_records;
+  };
+
+  static const uint32_t FILE_FORMAT_VERSION = 1;
+
+  //! Value of SLIsignalflag raised by a soft stop, see fuse_action 'stop'
+  static const int SOFT_STOP_SIGNAL = SIGUSR2;
+
+  //! Records collected before binary output is written, 1 MiB
+  static const size_t BINARY_BUFFER_RECORDS = 65536;
+
+  FileHeader_ make_file_header_( const uint64_t n_records ) const;
+
+  /**
+   * Fuse channel, guarding the senders in its GID ranges with its own
+   * thresholds.
+   */
+  struct Channel_
+  {
+    std::string name;
+    std::vector< long > gid_ranges; //!< pairs of first and last GID
+    double frequency_thresh;
+    double length_thresh;
+    double quiescence_thresh;
+    double quiescence_length;
+    long n_connected_neurons;
+  };
+
+  /**
+   * Entry of the per-sender trace table, an open-addressing hash table with
+   * linear probing, 12 bytes per slot. The trace is decayed lazily from
+   * last_step when the sender spikes again. Steps are kept modulo 2^32 and
+   * compared by their difference, which is exact for senders that spike at
+   * least once every 2^31 steps; the trace of a sender that is silent for
+   * longer has decayed to zero anyway.
+   */
+  struct SenderTrace_
+  {
+    uint32_t gid; //!< 0 marks an empty slot
+    float trace;
+    uint32_t last_step;
+  };
+
+  /**
+   * Bins of a count table row after the per-step bins, holding slice totals
+   * that are reduced over threads and processes together with the bins. They
+   * are followed by one bin per channel holding the number of connected
+   * senders.
+   */
+  enum ExtraBin_
+  {
+    RUNAWAY_SENDERS_BIN = 0, //!< senders that crossed neuron_rate_thresh
+    N_EXTRA_BINS
+  };
+
+  /**
+   * Global per-step spike counts of a slice. With several MPI processes, they
+   * are summed over all processes by the sibling on thread 0 and read by all
+   * siblings one slice later. With a single process, they are summed over
+   * threads by the first sibling to start the next slice.
+   */
+  struct GlobalCount_
+  {
+    long slice; //!< slice the counts belong to, -1 if not yet published
+    std::vector< double > n_spikes;
+  };
+
   /**
    * Buffer for incoming spikes.
    *
    * This data structure buffers all incoming spikes until they are
    * passed to the nest::RecordingDevice for storage or output during update().
    * update() always reads from spikes_[Network::get_network().read_toggle()]
-   * and deletes all events that have been read.
+   * and clears it after all records have been read. Clearing keeps the
+   * reserved memory, so each thread sibling reuses its two record vectors
+   * as an arena and no allocation takes place once they have grown to the
+   * size of the busiest slice.
    *
    * Events arriving from locally sending nodes, i.e., devices without
    * proxies, are stored in spikes_[Network::get_network().write_toggle()], to
@@ -231,7 +849,114 @@ private:
    */
   struct Buffers_
   {
-    std::vector< std::vector< nest::SpikeEvent* > > spikes_;
+    std::vector< std::vector< SpikeRecord_ > > spikes_;
+
+    /**
+     * Spike counts per step of the slice and channel, laid out as
+     * [step][channel] and followed by the extra bins, the sender bins and,
+     * if precise spikes exist, a second [step][channel] block of their
+     * weighted counts. They use the same read/write toggle scheme as
+     * spikes_. Spikes are binned by handle() using the position of their
+     * stamp modulo the slice length; update() rotates the bins to the start
+     * of the slice.
+     */
+    std::vector< std::vector< double > > step_spikes_;
+
+    /**
+     * Table of per-thread, per-step spike counts of the two most recent
+     * slices, laid out as [thread][slice parity][step][channel] with rows
+     * padded to whole cache lines and the table starting on one, so that
+     * siblings writing their rows do not share cache lines. It is only
+     * allocated on the sibling on thread 0; all siblings write to and read
+     * from it through shared_.
+     */
+    fuse_count_table thread_counts_;
+    fuse_count_table* shared_;
+
+    //! Per-step and per-channel counts of all threads, summed by update()
+    std::vector< double > step_sum_;
+
+    /**
+     * Per-sender traces, sized to a power of two by calibrate() for all
+     * senders connected to this sibling, so that handle() never allocates
+     */
+    std::vector< SenderTrace_ > sender_traces_;
+    size_t n_sender_traces_;
+
+    //! Senders that crossed neuron_rate_thresh on this thread
+    std::vector< long > runaway_senders_;
+
+    /**
+     * Global counts of the two most recent slices, indexed by slice parity,
+     * and the send/receive buffer for the reduction over MPI processes. Both
+     * are only allocated on the sibling on thread 0; all siblings read the
+     * counts through shared_global_.
+     */
+    GlobalCount_ global_counts_[ 2 ];
+    GlobalCount_* shared_global_;
+    std::vector< double > mpi_buffer_;
+
+    /**
+     * Ring of flight recorder segments. The segment slice % size holds the
+     * spikes delivered to this sibling in that slice; it is cleared when the
+     * ring wraps around to it.
+     */
+    std::vector< std::vector< FlightRecord_ > > flight_recorder_;
+
+    //! Binary output file of this sibling, see binary_output
+    std::ofstream binary_file_;
+    std::vector< FlightRecord_ > binary_buffer_;
+    uint64_t n_binary_records_; //!< records written to binary_file_
+
+    /**
+     * Sorted records of this sibling for ordered_output, indexed by slice
+     * parity, and the number of siblings that have finished the call to
+     * Simulate, which is only used on the sibling on thread 0.
+     */
+    std::vector< FlightRecord_ > ordered_records_[ 2 ];
+    long n_finalized_;
+
+    /**
+     * Unconsumed streamed events of this sibling, see stream_events.
+     * get_status() hands out these datums themselves, consuming events
+     * replaces them by fresh ones, so the reader keeps the old vectors.
+     */
+    IntVectorDatum stream_senders_;
+    DoubleVectorDatum stream_times_;
+
+    /**
+     * Ring of history entries, laid out as [entry] and [entry][channel], and
+     * the maximum danger level and the spike count of the interval being
+     * collected. Only used on the sibling on thread 0.
+     */
+    std::vector< double > history_times_;
+    std::vector< double > history_danger_;
+    std::vector< double > history_spikes_;
+    size_t history_next_;  //!< entry to be written next
+    size_t history_count_; //!< number of valid entries
+    std::vector< double > history_window_danger_;
+    std::vector< double > history_window_spikes_;
+    long history_window_slices_;
+
+    /**
+     * Population histogram of the spikes received by this sibling, laid out
+     * as [bin][channel], and the layout it was collected with.
+     */
+    std::vector< double > psth_;
+    long psth_steps_;
+    size_t psth_channels_;
+
+    //! Spikes offered for recording while decimating, see decimate_records_()
+    long n_decimated_;
+
+    //! Telemetry segment, only opened on the sibling on thread 0
+    FuseTelemetry telemetry_;
+
+    //! Switches of the load shedding tier, only kept on the sibling on thread 0
+    std::vector< double > shedding_times_;
+    std::vector< long > shedding_tiers_;
+
+    Buffers_();
   };
 
   struct Parameters_
@@ -239,6 +964,36 @@ private:
     double frequency_thresh;
     double length_thresh;
     long n_connected_neurons;
+    bool count_only; //!< only count spikes, do not buffer or record them
+    std::vector< Channel_ > channels;
+    double quiescence_thresh; //!< lower rate threshold in Hz, 0 disables
+    double quiescence_length; //!< time below quiescence_thresh in ms
+    double neuron_rate_thresh;   //!< per-sender rate limit in Hz, 0 disables
+    double neuron_length_thresh; //!< per-sender length in ms, 0 uses length_thresh
+    bool neuron_trip;            //!< trip on a runaway sender, or only report it
+    bool stop_on_trip;           //!< end Simulate instead of throwing
+    double flight_recorder_length; //!< ms of spikes kept for post-mortems, 0 disables
+    bool binary_output; //!< write spikes to a binary file instead of the device
+    bool ordered_output; //!< merge the binary output of all threads in time order
+    bool stream_events;    //!< keep spikes for incremental retrieval instead of the device
+    bool release_consumed; //!< do not keep the capacity of consumed stream columns
+    double history_interval; //!< resolution of the danger history in ms, 0 disables
+    long history_size;       //!< number of entries kept in the danger history
+    double predict_horizon;    //!< trip if the threshold is predicted within this many ms, 0 disables
+    double predict_window;     //!< time constant of the weights of the fit in ms
+    double predict_r_squared;  //!< goodness of fit required for a prediction
+    double predict_min_level;  //!< lowest rate relative to the threshold included in the fit
+    double synchrony_thresh; //!< Fano factor of the counts per step, 0 disables
+    double synchrony_length; //!< time above synchrony_thresh in ms
+    double synchrony_window; //!< time constant of the count statistics in ms
+    std::vector< double > shedding_levels; //!< danger levels of the load shedding tiers
+    long shedding_decimation;   //!< factor by which each tier reduces recording
+    double shedding_hysteresis; //!< margin below a level before its tier is left
+    double sample_fraction;     //!< fraction of the senders whose spikes are recorded
+    long sample_seed;           //!< seed of the hash choosing the recorded senders
+    std::vector< long > sample_gids; //!< senders to record, instead of sample_fraction
+    double psth_bin; //!< bin width of the population histogram in ms, 0 disables
+    std::string telemetry_name; //!< shared memory segment of the telemetry, empty disables
 
     Parameters_();
 
@@ -246,18 +1001,52 @@ private:
     void set(const DictionaryDatum &);  //!< Set values from dictionary
   };
 
+  /**
+   * State of the fuse besides the traces in core_. It is identical on all
+   * siblings.
+   */
   struct State_
   {
-    double danger_level;
-    long unstable_at_slice;
+    double n_runaway_senders; //!< senders that crossed neuron_rate_thresh
+    long slice; //!< slice of the most recent call to update()
+    bool fused;              //!< tripped with fuse_action 'stop', not yet rearmed
+    double fused_at;         //!< start of the slice in which the fuse tripped in ms
+    std::string fuse_reason; //!< message of the exception that was not thrown
+    long shedding_tier;         //!< current load shedding tier, 0 records all spikes
+    long recording_decimation;  //!< every how many spikes one is recorded, 0 for none
 
     State_();
+
+    void get(DictionaryDatum &) const;  //!< Store current values in dictionary
+    void set(const DictionaryDatum &);  //!< Rearm the fuse if fused is set to false
   };
 
   struct Variables_
   {
-    double danger_decay_factor;
-    double danger_increment_step;
+    std::vector< double > offset_decay_rate;     //!< log of the weight of precise spikes per ms
+    std::vector< fuse_gid_range > gid_ranges;    //!< ranges of all channels, sorted by first
+    size_t n_channels;
+    long slice_steps;    //!< number of steps per slice (min_delay)
+    size_t extra_offset; //!< index of the first extra bin, slice_steps * n_channels
+    size_t row_length;   //!< number of bins per slice including extra bins
+    size_t row_stride; //!< row_length padded to whole cache lines
+
+    double neuron_decay_rate;     //!< log of the per-sender trace decay per step
+    double neuron_increment_step; //!< per-sender trace increment per spike
+
+    size_t flight_segments; //!< number of flight recorder segments, 0 if disabled
+    long history_slices;    //!< slices per history entry, 0 if disabled
+    long psth_steps;        //!< steps per histogram bin, 0 if disabled
+
+    std::vector< Channel_ > channels; //!< channels in use, including the implicit one
+    std::vector< double > n_neurons;  //!< neurons each channel is calibrated for
+    std::vector< double > n_local_senders; //!< senders connected to this sibling per channel
+    size_t senders_offset; //!< index of the first per-channel sender bin
+    size_t weighted_offset; //!< index of the first weighted bin of precise spikes
+    bool weighted_bins;     //!< precise spikes are also binned by their weight
+    double step_ms;
+
+    fuse_gid_sampler sampler; //!< senders whose spikes are recorded
 
     Variables_();
   };
@@ -269,42 +1058,68 @@ private:
   State_ S_;
   Variables_ V_;
 
+  //! Traces of all channels with their constants, identical on all siblings
+  Core_ core_;
+
   bool has_proxies_;
   bool local_receiver_;
+
+  //! Distinct GIDs of the senders connected to this sibling, sorted
+  std::vector< long > connected_senders_;
+
+#ifdef SPIKE_DETECTOR_FUSE_STATS
+  //! Hot-path counters of this sibling, see fuse_stats.h
+  FuseStats stats_;
+#endif
 };
 
+template < typename TKernel >
 inline void
-spike_detector_fuse::set_has_proxies( const bool hp )
+basic_spike_detector_fuse< TKernel >::set_has_proxies( const bool hp )
 {
   has_proxies_ = hp;
 }
 
+template < typename TKernel >
 inline void
-spike_detector_fuse::set_local_receiver( const bool lr )
+basic_spike_detector_fuse< TKernel >::set_local_receiver( const bool lr )
 {
   local_receiver_ = lr;
 }
 
+template < typename TKernel >
 inline nest::port
-spike_detector_fuse::handles_test_event( nest::SpikeEvent&, nest::rport receptor_type )
+basic_spike_detector_fuse< TKernel >::handles_test_event( nest::SpikeEvent& e, nest::rport receptor_type )
 {
   if ( receptor_type != 0 )
     throw nest::UnknownReceptorType( receptor_type, get_name() );
-  return 0;
-}
 
-inline void
-spike_detector_fuse::finalize()
-{
-  device_.finalize();
+  // Populations are usually connected in ascending order of their GIDs, so
+  // that the sender is appended in most cases
+  const long gid = e.get_sender().get_gid();
+  if ( connected_senders_.empty() or connected_senders_.back() < gid )
+    connected_senders_.push_back( gid );
+  else
+  {
+    std::vector< long >::iterator it =
+        std::lower_bound( connected_senders_.begin(), connected_senders_.end(), gid );
+    if ( *it != gid )
+      connected_senders_.insert( it, gid );
+  }
+  return 0;
 }
 
+template < typename TKernel >
 inline nest::SignalType
-spike_detector_fuse::receives_signal() const
+basic_spike_detector_fuse< TKernel >::receives_signal() const
 {
   return nest::ALL;
 }
 
+typedef basic_spike_detector_fuse< exponential_kernel > spike_detector_fuse;
+typedef basic_spike_detector_fuse< boxcar_kernel > spike_detector_fuse_boxcar;
+typedef basic_spike_detector_fuse< cusum_kernel > spike_detector_fuse_cusum;
+
 } // namespace
 
 #endif /* #ifndef SPIKE_DETECTOR_H */
@@ -0,0 +1,1787 @@
+/*
+ *  spike_detector_fuse_impl.h
+ *
+ *  This file is part of NEST.
+ *
+ *  Copyright (C) 2004 The NEST Initiative
+ *
+ *  NEST is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  NEST is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with NEST.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SPIKE_DETECTOR_FUSE_IMPL_H
+#define SPIKE_DETECTOR_FUSE_IMPL_H
+
+#include "spike_detector_fuse.h"
+
+// C++ includes:
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <numeric>
+
+// Includes from libnestutil:
+#include "compose.hpp"
+#include "logging.h"
+
+// Includes from nestkernel:
+#include "event_delivery_manager_impl.h"
+#include "io_manager.h"
+#include "kernel_manager.h"
+#include "mpi_manager.h"
+#include "sibling_container.h"
+
+// Includes from sli:
+#include "arraydatum.h"
+#include "dict.h"
+#include "dictutils.h"
+#include "doubledatum.h"
+#include "doublevectordatum.h"
+#include "integerdatum.h"
+#include "interpret.h"
+#include "intvectordatum.h"
+
+template < typename TKernel >
+mynest::basic_spike_detector_fuse< TKernel >::basic_spike_detector_fuse()
+    : nest::Node()
+    // record time and gid
+    , device_( *this, nest::RecordingDevice::SPIKE_DETECTOR, "gdf", true, true )
+    , P_()
+    , S_()
+    , V_()
+    , core_()
+    , has_proxies_( false )
+    , local_receiver_( true )
+{
+}
+
+template < typename TKernel >
+mynest::basic_spike_detector_fuse< TKernel >::basic_spike_detector_fuse( const basic_spike_detector_fuse& n )
+    : nest::Node( n )
+    , device_( *this, n.device_ )
+    , P_(n.P_)
+    , S_(n.S_)
+    , V_(n.V_)
+    , core_(n.core_)
+    , has_proxies_( false )
+    , local_receiver_( true )
+{
+}
+
+template < typename TKernel >
+mynest::basic_spike_detector_fuse< TKernel >::Parameters_::Parameters_()
+    : frequency_thresh(0.0)
+    , length_thresh(0.0)
+    , n_connected_neurons(0)
+    , count_only(false)
+    , channels()
+    , quiescence_thresh(0.0)
+    , quiescence_length(0.0)
+    , neuron_rate_thresh(0.0)
+    , neuron_length_thresh(0.0)
+    , neuron_trip(true)
+    , stop_on_trip(false)
+    , flight_recorder_length(0.0)
+    , binary_output(false)
+    , ordered_output(false)
+    , stream_events(false)
+    , release_consumed(false)
+    , history_interval(0.0)
+    , history_size(1000)
+    , predict_horizon(0.0)
+    , predict_window(20.0)
+    , predict_r_squared(0.95)
+    , predict_min_level(0.1)
+    , synchrony_thresh(0.0)
+    , synchrony_length(100.0)
+    , synchrony_window(100.0)
+    , shedding_levels()
+    , shedding_decimation(10)
+    , shedding_hysteresis(0.1)
+    , sample_fraction(1.0)
+    , sample_seed(0)
+    , sample_gids()
+    , psth_bin(0.0)
+    , telemetry_name()
+{}
+
+template < typename TKernel >
+mynest::basic_spike_detector_fuse< TKernel >::State_::State_()
+    : n_runaway_senders(0.0)
+    , slice(-1)
+    , fused(false)
+    , fused_at(0.0)
+    , fuse_reason()
+    , shedding_tier(0)
+    , recording_decimation(1)
+{}
+
+template < typename TKernel >
+mynest::basic_spike_detector_fuse< TKernel >::Buffers_::Buffers_()
+    : shared_(0)
+    , n_sender_traces_(0)
+    , shared_global_(0)
+    , n_binary_records_(0)
+    , n_finalized_(0)
+    , history_next_(0)
+    , history_count_(0)
+    , history_window_slices_(0)
+    , psth_steps_(0)
+    , psth_channels_(0)
+    , n_decimated_(0)
+{}
+
+template < typename TKernel >
+mynest::basic_spike_detector_fuse< TKernel >::Variables_::Variables_()
+    : offset_decay_rate()
+    , gid_ranges()
+    , n_channels(0)
+    , slice_steps(0)
+    , extra_offset(0)
+    , row_length(0)
+    , row_stride(0)
+    , neuron_decay_rate(0.0)
+    , neuron_increment_step(0.0)
+    , flight_segments(0)
+    , history_slices(0)
+    , psth_steps(0)
+    , channels()
+    , n_neurons()
+    , n_local_senders()
+    , senders_offset(0)
+    , weighted_offset(0)
+    , weighted_bins(false)
+    , step_ms(0.0)
+{}
+
+template < typename TKernel >
+void mynest::basic_spike_detector_fuse< TKernel >::Parameters_::set(const DictionaryDatum &d)
+{
+  updateValue<double>(d, "frequency_thresh", frequency_thresh);
+  updateValue<double>(d, "length_thresh", length_thresh);
+  updateValue<long>(d, "n_connected_neurons", n_connected_neurons);
+  updateValue<bool>(d, "count_only", count_only);
+  updateValue<double>(d, "quiescence_thresh", quiescence_thresh);
+  updateValue<double>(d, "quiescence_length", quiescence_length);
+  updateValue<double>(d, "neuron_rate_thresh", neuron_rate_thresh);
+  updateValue<double>(d, "neuron_length_thresh", neuron_length_thresh);
+  updateValue<double>(d, "flight_recorder_length", flight_recorder_length);
+  updateValue<bool>(d, "binary_output", binary_output);
+  updateValue<bool>(d, "stream_events", stream_events);
+  updateValue<bool>(d, "release_consumed", release_consumed);
+  updateValue<bool>(d, "ordered_output", ordered_output);
+  updateValue<double>(d, "history_interval", history_interval);
+  updateValue<long>(d, "history_size", history_size);
+  updateValue<double>(d, "predict_horizon", predict_horizon);
+  updateValue<double>(d, "predict_window", predict_window);
+  updateValue<double>(d, "predict_r_squared", predict_r_squared);
+  updateValue<double>(d, "predict_min_level", predict_min_level);
+  updateValue<double>(d, "synchrony_thresh", synchrony_thresh);
+  updateValue<double>(d, "synchrony_length", synchrony_length);
+  updateValue<double>(d, "synchrony_window", synchrony_window);
+  updateValue<std::vector<double> >(d, "shedding_levels", shedding_levels);
+  updateValue<long>(d, "shedding_decimation", shedding_decimation);
+  updateValue<double>(d, "shedding_hysteresis", shedding_hysteresis);
+  updateValue<double>(d, "sample_fraction", sample_fraction);
+  updateValue<long>(d, "sample_seed", sample_seed);
+  updateValue<std::vector<long> >(d, "sample_gids", sample_gids);
+  updateValue<double>(d, "psth_bin", psth_bin);
+  updateValue<std::string>(d, "telemetry_name", telemetry_name);
+
+  std::string neuron_action;
+  if (updateValue<std::string>(d, "neuron_action", neuron_action)) {
+    if (neuron_action != "trip" && neuron_action != "report") {
+      throw nest::BadParameter("neuron_action must be 'trip' or 'report'");
+    }
+    neuron_trip = neuron_action == "trip";
+  }
+
+  std::string fuse_action;
+  if (updateValue<std::string>(d, "fuse_action", fuse_action)) {
+    if (fuse_action != "abort" && fuse_action != "stop") {
+      throw nest::BadParameter("fuse_action must be 'abort' or 'stop'");
+    }
+    stop_on_trip = fuse_action == "stop";
+  }
+
+  if (frequency_thresh < 0 || length_thresh < 0 || n_connected_neurons < 0) {
+    throw nest::BadParameter("length_thresh, frequency_thresh, and n_connected_neurons must be non-negative");
+  }
+  if (quiescence_thresh < 0 || quiescence_length < 0) {
+    throw nest::BadParameter("quiescence_thresh and quiescence_length must be non-negative");
+  }
+  if (neuron_rate_thresh < 0 || neuron_length_thresh < 0) {
+    throw nest::BadParameter("neuron_rate_thresh and neuron_length_thresh must be non-negative");
+  }
+  if (flight_recorder_length < 0) {
+    throw nest::BadParameter("flight_recorder_length must be non-negative");
+  }
+  if (history_interval < 0 || history_size < 1) {
+    throw nest::BadParameter("history_interval must be non-negative and history_size positive");
+  }
+  if (predict_horizon < 0 || predict_window <= 0) {
+    throw nest::BadParameter("predict_horizon must be non-negative and predict_window positive");
+  }
+  if (predict_r_squared < 0 || predict_r_squared > 1 || predict_min_level <= 0 || predict_min_level >= 1) {
+    throw nest::BadParameter("predict_r_squared must be in [0, 1] and predict_min_level in (0, 1)");
+  }
+  if (synchrony_thresh < 0 || synchrony_length < 0 || synchrony_window <= 0) {
+    throw nest::BadParameter("synchrony_thresh and synchrony_length must be non-negative and synchrony_window positive");
+  }
+  for (size_t i = 0; i < shedding_levels.size(); ++i) {
+    if (shedding_levels[i] <= 0 || (i > 0 && shedding_levels[i] <= shedding_levels[i - 1])) {
+      throw nest::BadParameter("shedding_levels must be positive and strictly increasing");
+    }
+  }
+  if (shedding_decimation < 2 || shedding_hysteresis < 0) {
+    throw nest::BadParameter("shedding_decimation must be at least 2 and shedding_hysteresis non-negative");
+  }
+  if (ordered_output && !binary_output) {
+    throw nest::BadParameter("ordered_output requires binary_output");
+  }
+  if (!telemetry_name.empty() && (telemetry_name[0] != '/' || telemetry_name.find('/', 1) != std::string::npos)) {
+    throw nest::BadParameter("telemetry_name must be empty or a slash followed by a name without slashes");
+  }
+  if (psth_bin < 0) {
+    throw nest::BadParameter("psth_bin must be non-negative");
+  }
+  if (sample_fraction < 0 || sample_fraction > 1) {
+    throw nest::BadParameter("sample_fraction must be between 0 and 1");
+  }
+  for (size_t i = 0; i < sample_gids.size(); ++i) {
+    if (sample_gids[i] < 1) {
+      throw nest::BadParameter("sample_gids must be valid GIDs");
+    }
+  }
+
+  if (d->known("channels")) {
+    const ArrayDatum channel_dicts = getValue<ArrayDatum>(d, "channels");
+    std::vector<Channel_> new_channels(channel_dicts.size());
+    std::vector<fuse_gid_range> ranges;
+
+    for (size_t i = 0; i < channel_dicts.size(); ++i) {
+      const DictionaryDatum cd = getValue<DictionaryDatum>(channel_dicts[i]);
+      Channel_& ch = new_channels[i];
+
+      // Thresholds default to the ones of the device. The number of neurons
+      // is counted from the connections unless it is given.
+      ch.name = "channel_" + numberToString(i);
+      ch.frequency_thresh = frequency_thresh;
+      ch.length_thresh = length_thresh;
+      ch.quiescence_thresh = quiescence_thresh;
+      ch.quiescence_length = quiescence_length;
+      ch.n_connected_neurons = 0;
+
+      updateValue<std::string>(cd, "name", ch.name);
+      updateValue<std::vector<long> >(cd, "gid_ranges", ch.gid_ranges);
+      updateValue<double>(cd, "frequency_thresh", ch.frequency_thresh);
+      updateValue<double>(cd, "length_thresh", ch.length_thresh);
+      updateValue<double>(cd, "quiescence_thresh", ch.quiescence_thresh);
+      updateValue<double>(cd, "quiescence_length", ch.quiescence_length);
+
+      if (ch.gid_ranges.empty() || ch.gid_ranges.size() % 2 != 0) {
+        throw nest::BadParameter("gid_ranges of channel " + ch.name + " must be a non-empty list of first and last GIDs");
+      }
+      for (size_t r = 0; r < ch.gid_ranges.size(); r += 2) {
+        if (ch.gid_ranges[r] < 1 || ch.gid_ranges[r] > ch.gid_ranges[r + 1]) {
+          throw nest::BadParameter("gid_ranges of channel " + ch.name + " contains an invalid range");
+        }
+        const fuse_gid_range range = { ch.gid_ranges[r], ch.gid_ranges[r + 1], i };
+        ranges.push_back(range);
+      }
+      updateValue<long>(cd, "n_connected_neurons", ch.n_connected_neurons);
+
+      if (ch.frequency_thresh < 0 || ch.length_thresh < 0 || ch.n_connected_neurons < 0
+          || ch.quiescence_thresh < 0 || ch.quiescence_length < 0) {
+        throw nest::BadParameter("length_thresh, frequency_thresh, quiescence_thresh, quiescence_length, and "
+                                 "n_connected_neurons of channel " + ch.name + " must be non-negative");
+      }
+    }
+
+    std::sort(ranges.begin(), ranges.end());
+    for (size_t r = 1; r < ranges.size(); ++r) {
+      if (ranges[r].first <= ranges[r - 1].last) {
+        throw nest::BadParameter("gid_ranges of channels must not overlap");
+      }
+    }
+
+    channels.swap(new_channels);
+  }
+}
+
+template < typename TKernel >
+void mynest::basic_spike_detector_fuse< TKernel >::Parameters_::get(DictionaryDatum &d) const
+{
+  def<double>(d, "frequency_thresh", frequency_thresh);
+  def<double>(d, "length_thresh", length_thresh);
+  def<long>(d, "n_connected_neurons", n_connected_neurons);
+  def<bool>(d, "count_only", count_only);
+  def<double>(d, "quiescence_thresh", quiescence_thresh);
+  def<double>(d, "quiescence_length", quiescence_length);
+  def<double>(d, "neuron_rate_thresh", neuron_rate_thresh);
+  def<double>(d, "neuron_length_thresh", neuron_length_thresh);
+  def<double>(d, "flight_recorder_length", flight_recorder_length);
+  def<bool>(d, "binary_output", binary_output);
+  def<bool>(d, "stream_events", stream_events);
+  def<bool>(d, "release_consumed", release_consumed);
+  def<bool>(d, "ordered_output", ordered_output);
+  def<double>(d, "history_interval", history_interval);
+  def<long>(d, "history_size", history_size);
+  def<double>(d, "predict_horizon", predict_horizon);
+  def<double>(d, "predict_window", predict_window);
+  def<double>(d, "predict_r_squared", predict_r_squared);
+  def<double>(d, "predict_min_level", predict_min_level);
+  def<double>(d, "synchrony_thresh", synchrony_thresh);
+  def<double>(d, "synchrony_length", synchrony_length);
+  def<double>(d, "synchrony_window", synchrony_window);
+  def<std::vector<double> >(d, "shedding_levels", shedding_levels);
+  def<long>(d, "shedding_decimation", shedding_decimation);
+  def<double>(d, "shedding_hysteresis", shedding_hysteresis);
+  def<double>(d, "sample_fraction", sample_fraction);
+  def<long>(d, "sample_seed", sample_seed);
+  def<std::vector<long> >(d, "sample_gids", sample_gids);
+  def<double>(d, "psth_bin", psth_bin);
+  def<std::string>(d, "telemetry_name", telemetry_name);
+  def<std::string>(d, "neuron_action", neuron_trip ? "trip" : "report");
+  def<std::string>(d, "fuse_action", stop_on_trip ? "stop" : "abort");
+
+  ArrayDatum channel_dicts;
+  for (typename std::vector<Channel_>::const_iterator ch = channels.begin(); ch != channels.end(); ++ch) {
+    DictionaryDatum cd(new Dictionary);
+    def<std::string>(cd, "name", ch->name);
+    def<std::vector<long> >(cd, "gid_ranges", ch->gid_ranges);
+    def<double>(cd, "frequency_thresh", ch->frequency_thresh);
+    def<double>(cd, "length_thresh", ch->length_thresh);
+    def<double>(cd, "quiescence_thresh", ch->quiescence_thresh);
+    def<double>(cd, "quiescence_length", ch->quiescence_length);
+    def<long>(cd, "n_connected_neurons", ch->n_connected_neurons);
+    channel_dicts.push_back(new DictionaryDatum(cd));
+  }
+  (*d)["channels"] = channel_dicts;
+}
+
+template < typename TKernel >
+void mynest::basic_spike_detector_fuse< TKernel >::State_::get(DictionaryDatum &d) const
+{
+  def<bool>(d, "fused", fused);
+  def<double>(d, "fused_at", fused_at);
+  def<std::string>(d, "fuse_reason", fuse_reason);
+  def<long>(d, "shedding_tier", shedding_tier);
+  def<long>(d, "n_runaway_senders", static_cast<long>(n_runaway_senders));
+}
+
+template < typename TKernel >
+void mynest::basic_spike_detector_fuse< TKernel >::State_::set(const DictionaryDatum &d)
+{
+  bool new_fused = fused;
+  updateValue<bool>(d, "fused", new_fused);
+  if (new_fused && !fused) {
+    throw nest::BadParameter("fused can only be set to false, to rearm the fuse");
+  }
+
+  // Rearming restarts all traces, as they are still above threshold when the
+  // fuse has tripped. The traces in core_ and the per-sender traces are
+  // restarted by set_status().
+  if (fused && !new_fused) {
+    n_runaway_senders = 0.0;
+    fused = false;
+    fused_at = 0.0;
+    fuse_reason.clear();
+  }
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::init_state_( const nest::Node& np )
+{
+  const basic_spike_detector_fuse& sd = dynamic_cast< const basic_spike_detector_fuse& >( np );
+  device_.init_state( sd.device_ );
+  P_ = sd.P_;
+  S_ = sd.S_;
+  V_ = sd.V_;
+  core_ = sd.core_;
+  init_buffers_();
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::init_buffers_()
+{
+  device_.init_buffers();
+
+  std::vector< std::vector< SpikeRecord_ > > tmp( 2, std::vector< SpikeRecord_ >() );
+  B_.spikes_.swap( tmp );
+
+  // The per-step buffers are sized in calibrate(), when min_delay is known
+  B_.step_spikes_.assign( 2, std::vector< double >() );
+  B_.step_sum_.clear();
+  B_.thread_counts_.clear();
+  B_.global_counts_[ 0 ].slice = B_.global_counts_[ 1 ].slice = -1;
+  B_.global_counts_[ 0 ].n_spikes.clear();
+  B_.global_counts_[ 1 ].n_spikes.clear();
+  B_.mpi_buffer_.clear();
+
+  B_.sender_traces_.clear();
+  B_.n_sender_traces_ = 0;
+  B_.runaway_senders_.clear();
+  B_.flight_recorder_.clear();
+  B_.binary_buffer_.clear();
+  B_.ordered_records_[ 0 ].clear();
+  B_.ordered_records_[ 1 ].clear();
+  B_.n_finalized_ = 0;
+  B_.stream_senders_ = IntVectorDatum( new std::vector< long >() );
+  B_.stream_times_ = DoubleVectorDatum( new std::vector< double >() );
+  B_.history_times_.clear();
+  B_.history_danger_.clear();
+  B_.history_spikes_.clear();
+  B_.psth_.clear();
+  B_.n_decimated_ = 0;
+  B_.shedding_times_.clear();
+  B_.shedding_tiers_.clear();
+
+  B_.shared_ = 0;
+  B_.shared_global_ = 0;
+
+#ifdef SPIKE_DETECTOR_FUSE_STATS
+  stats_.reset();
+#endif
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::calibrate()
+{
+
+  if ( nest::kernel().event_delivery_manager.get_off_grid_communication()
+       and not device_.is_precise_times_user_set() )
+  {
+    device_.set_precise_times( true );
+    std::string msg = String::compose(
+        "Precise neuron models exist: the property precise_times "
+            "of the %1 with gid %2 has been set to true",
+        get_name(),
+        get_gid() );
+
+    if ( device_.is_precision_user_set() )
+    {
+      // if user explicitly set the precision, there is no need to do anything.
+      msg += ".";
+    }
+
+    else
+    {
+      // it makes sense to increase the precision if precise models are used.
+      device_.set_precision( 15 );
+      msg += ", precision has been set to 15.";
+    }
+
+    LOG( nest::M_INFO, "spike_detector_fuse::calibrate", msg );
+  }
+
+  // Without explicit channels, a single channel guards all senders with the
+  // parameters of the device
+  std::vector< Channel_ > channels = P_.channels;
+  V_.gid_ranges.clear();
+  if ( channels.empty() )
+  {
+    Channel_ all;
+    all.frequency_thresh = P_.frequency_thresh;
+    all.length_thresh = P_.length_thresh;
+    all.quiescence_thresh = P_.quiescence_thresh;
+    all.quiescence_length = P_.quiescence_length;
+    all.n_connected_neurons = P_.n_connected_neurons;
+    channels.push_back( all );
+  }
+  else
+  {
+    for ( size_t c = 0; c < channels.size(); ++c )
+      for ( size_t r = 0; r < channels[ c ].gid_ranges.size(); r += 2 )
+      {
+        const fuse_gid_range range = { channels[ c ].gid_ranges[ r ], channels[ c ].gid_ranges[ r + 1 ], c };
+        V_.gid_ranges.push_back( range );
+      }
+    std::sort( V_.gid_ranges.begin(), V_.gid_ranges.end() );
+  }
+  V_.n_channels = channels.size();
+  V_.channels.swap( channels );
+
+  core_.resize( V_.n_channels );
+  V_.offset_decay_rate.assign( V_.n_channels, 0.0 );
+  V_.n_neurons.assign( V_.n_channels, 0.0 );
+
+  V_.step_ms = nest::Time::get_resolution().get_ms();
+  const double step_ms = V_.step_ms;
+  V_.slice_steps = nest::kernel().connection_manager.get_min_delay();
+  core_.configure_prediction( P_.predict_horizon,
+    P_.predict_window,
+    P_.predict_r_squared,
+    P_.predict_min_level,
+    V_.slice_steps * step_ms );
+  core_.configure_synchrony( P_.synchrony_thresh, P_.synchrony_length, P_.synchrony_window, step_ms );
+
+  // Count the distinct senders connected to this sibling per channel. They
+  // are summed over all threads and processes with the spike counts.
+  V_.n_local_senders.assign( V_.n_channels, 0.0 );
+  for ( std::vector< long >::const_iterator gid = connected_senders_.begin(); gid != connected_senders_.end(); ++gid )
+  {
+    const size_t channel = channel_of_( *gid );
+    if ( channel < V_.n_channels )
+      V_.n_local_senders[ channel ] += 1.0;
+  }
+
+  // Channels with a given number of neurons are calibrated here, all others
+  // as soon as the number of connected senders of all threads is known, in
+  // the first slice
+  bool fusing = false;
+  for ( size_t c = 0; c < V_.n_channels; ++c )
+  {
+    const Channel_& ch = V_.channels[ c ];
+
+    // Validate Parameters. If any of them is 0, no termination is performed
+    // and the constants of the channel remain 0
+    if ( ( ch.length_thresh > 0 && ch.frequency_thresh > 0 )
+      || ( ch.quiescence_length > 0 && ch.quiescence_thresh > 0 ) ) {
+      fusing = true;
+    }
+    if ( ch.n_connected_neurons > 0 ) {
+      calibrate_channel_( c, ch.n_connected_neurons );
+    }
+  }
+
+  // The per-sender traces follow the same calibration as a channel
+  // consisting of a single neuron
+  V_.neuron_decay_rate = 0.0;
+  V_.neuron_increment_step = 0.0;
+  const double neuron_length_thresh = P_.neuron_length_thresh > 0 ? P_.neuron_length_thresh : P_.length_thresh;
+  if (P_.neuron_rate_thresh > 0 && neuron_length_thresh > 0) {
+    fusing = true;
+
+    double neuron_decay_factor;
+    calibrate_trace( P_.neuron_rate_thresh, neuron_length_thresh, 1, step_ms,
+                     neuron_decay_factor, V_.neuron_increment_step );
+    V_.neuron_decay_rate = std::log(neuron_decay_factor);
+
+    // The table holds every connected sender at a load factor of at most
+    // 1/2, so that probe sequences stay short. Traces are kept if it grows.
+    size_t size = 64;
+    while ( size < 2 * connected_senders_.size() )
+      size *= 2;
+    if ( B_.sender_traces_.size() < size )
+    {
+      const SenderTrace_ empty = { 0, 0.0f, 0 };
+      std::vector< SenderTrace_ > old( size, empty );
+      old.swap( B_.sender_traces_ );
+
+      const size_t mask = size - 1;
+      for ( typename std::vector< SenderTrace_ >::const_iterator t = old.begin(); t != old.end(); ++t )
+        if ( t->gid != 0 )
+        {
+          size_t i = fuse_gid_sampler::hash( t->gid ) & mask;
+          while ( B_.sender_traces_[ i ].gid != 0 )
+            i = ( i + 1 ) & mask;
+          B_.sender_traces_[ i ] = *t;
+        }
+    }
+  }
+
+  if (not fusing and get_thread() == 0) {
+    std::string msg;
+    msg += "GID: ";
+    msg += numberToString(this->get_gid());
+    msg += " Spike Detector Not Fusing";
+    LOG( nest::M_WARNING, "spike_detector_fuse::calibrate", msg);
+  }
+
+  // Size the per-step buffers. They keep their contents if neither the slice
+  // length nor the number of channels changed, since the counts of the last
+  // slice of the previous simulation are only folded into the danger trace
+  // in the next slice.
+  V_.extra_offset = V_.slice_steps * V_.n_channels;
+  V_.senders_offset = V_.extra_offset + N_EXTRA_BINS;
+  V_.weighted_offset = V_.senders_offset + V_.n_channels;
+  V_.weighted_bins = nest::kernel().event_delivery_manager.get_off_grid_communication();
+  V_.row_length = V_.weighted_offset + ( V_.weighted_bins ? V_.extra_offset : 0 );
+  const size_t doubles_per_line = CACHE_LINE_SIZE / sizeof( double );
+  V_.row_stride = ( V_.row_length + doubles_per_line - 1 ) / doubles_per_line * doubles_per_line;
+
+  if ( B_.step_sum_.size() != V_.row_length )
+  {
+    B_.step_spikes_[ 0 ].assign( V_.row_length, 0.0 );
+    B_.step_spikes_[ 1 ].assign( V_.row_length, 0.0 );
+    B_.step_sum_.assign( V_.row_length, 0.0 );
+
+    // The sibling on thread 0 holds the table of per-thread counts
+    if ( get_thread() == 0 )
+    {
+      B_.thread_counts_.assign( nest::kernel().vp_manager.get_num_threads() * 2 * V_.row_stride, 0.0 );
+      B_.global_counts_[ 0 ].slice = B_.global_counts_[ 1 ].slice = -1;
+      B_.global_counts_[ 0 ].n_spikes.assign( V_.row_length, 0.0 );
+      B_.global_counts_[ 1 ].n_spikes.assign( V_.row_length, 0.0 );
+      B_.mpi_buffer_.assign( V_.row_length, 0.0 );
+    }
+    core_.reset();
+    S_.slice = -1;
+  }
+
+  // The flight recorder keeps one segment per slice. Segments are reused
+  // round-robin, and enough of them are kept to always cover
+  // flight_recorder_length in addition to the slice being filled.
+  V_.flight_segments = 0;
+  if ( P_.flight_recorder_length > 0 )
+  {
+    const long length_steps = nest::Time( nest::Time::ms( P_.flight_recorder_length ) ).get_steps();
+    V_.flight_segments = ( length_steps + V_.slice_steps - 1 ) / V_.slice_steps + 2;
+  }
+  if ( B_.flight_recorder_.size() != V_.flight_segments )
+    B_.flight_recorder_.assign( V_.flight_segments, std::vector< FlightRecord_ >() );
+
+  // The history is decimated to whole slices and only kept by the sibling on
+  // thread 0, as the traces are identical on all siblings. It is restarted
+  // if its layout changes.
+  V_.history_slices = 0;
+  if ( P_.history_interval > 0 )
+    V_.history_slices =
+        std::max( 1L, nest::Time( nest::Time::ms( P_.history_interval ) ).get_steps() / V_.slice_steps );
+  if ( get_thread() == 0 and V_.history_slices > 0
+    and B_.history_danger_.size() != static_cast< size_t >( P_.history_size ) * V_.n_channels )
+  {
+    B_.history_times_.assign( P_.history_size, 0.0 );
+    B_.history_danger_.assign( P_.history_size * V_.n_channels, 0.0 );
+    B_.history_spikes_.assign( P_.history_size * V_.n_channels, 0.0 );
+    B_.history_window_danger_.assign( V_.n_channels, 0.0 );
+    B_.history_window_spikes_.assign( V_.n_channels, 0.0 );
+    B_.history_next_ = 0;
+    B_.history_count_ = 0;
+    B_.history_window_slices_ = 0;
+  }
+
+  V_.sampler.configure( P_.sample_fraction, P_.sample_seed, P_.sample_gids );
+
+  // The histogram is restarted if its layout changes. If the device stops
+  // recording at a given time, it is allocated once for the whole recording,
+  // otherwise for the spikes that can be delivered before the first update().
+  V_.psth_steps = 0;
+  if ( P_.psth_bin > 0 )
+    V_.psth_steps = std::max( 1L, nest::Time( nest::Time::ms( P_.psth_bin ) ).get_steps() );
+  if ( B_.psth_steps_ != V_.psth_steps or B_.psth_channels_ != V_.n_channels )
+  {
+    B_.psth_.clear();
+    B_.psth_steps_ = V_.psth_steps;
+    B_.psth_channels_ = V_.n_channels;
+  }
+  if ( V_.psth_steps > 0 )
+  {
+    long steps = nest::kernel().simulation_manager.get_time().get_steps() + 2 * V_.slice_steps;
+    if ( device_.get_stop().is_finite() )
+      steps = std::max( steps, ( device_.get_origin() + device_.get_stop() ).get_steps() );
+    grow_psth_( steps );
+  }
+
+  // The shedding levels may have changed since the tier was entered
+  S_.shedding_tier = std::min( S_.shedding_tier, static_cast< long >( P_.shedding_levels.size() ) );
+  S_.recording_decimation = 1;
+  for ( long k = 0; k < S_.shedding_tier; ++k )
+    S_.recording_decimation *= P_.shedding_decimation;
+  if ( S_.shedding_tier > 0 and S_.shedding_tier == static_cast< long >( P_.shedding_levels.size() ) )
+    S_.recording_decimation = 0;
+
+  // The binary file is opened once and kept open over successive calls to
+  // Simulate. Ordered output is only written by the sibling on thread 0.
+  if ( P_.binary_output and not B_.binary_file_.is_open() and ( not P_.ordered_output or get_thread() == 0 ) )
+    open_binary_file_();
+
+  // The telemetry segment is kept over successive calls to Simulate, so that
+  // readers stay attached, and only recreated if its name changes. All
+  // processes have the same danger levels, the first one publishes them.
+  if ( get_thread() == 0 and nest::kernel().mpi_manager.get_rank() == 0 )
+  {
+    if ( P_.telemetry_name != B_.telemetry_.name() )
+    {
+      B_.telemetry_.close();
+      if ( not P_.telemetry_name.empty() and not B_.telemetry_.open( P_.telemetry_name, get_gid(), V_.n_channels ) )
+      {
+        LOG( nest::M_ERROR,
+          "spike_detector_fuse::calibrate",
+          String::compose(
+            "Could not create the shared memory segment %1, or it is used by another writer.", P_.telemetry_name ) );
+        throw nest::IOError();
+      }
+    }
+    else if ( B_.telemetry_.is_open() )
+    {
+      fuse_telemetry_record* record = B_.telemetry_.begin_write();
+      record->n_channels = std::min( V_.n_channels, static_cast< size_t >( FUSE_TELEMETRY_CHANNELS ) );
+      B_.telemetry_.end_write();
+    }
+  }
+
+  // All siblings share the count table and global counts of the sibling on
+  // thread 0
+  const nest::SiblingContainer* siblings =
+      nest::kernel().node_manager.get_thread_siblings( get_gid() );
+  basic_spike_detector_fuse& root = downcast< basic_spike_detector_fuse >( **siblings->begin() );
+  B_.shared_ = &root.B_.thread_counts_;
+  B_.shared_global_ = root.B_.global_counts_;
+
+  device_.calibrate();
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::update( nest::Time const& Now, const long from, const long to)
+{
+#ifdef SPIKE_DETECTOR_FUSE_STATS
+  CycleTimer timer( stats_.update_cycles );
+#endif
+
+  const long read_toggle = nest::kernel().event_delivery_manager.read_toggle();
+  const long slice = nest::kernel().simulation_manager.get_slice();
+
+  std::vector< SpikeRecord_ >& spikes = B_.spikes_[ read_toggle ];
+#ifdef SPIKE_DETECTOR_FUSE_STATS
+  stats_.peak_buffered = std::max< uint64_t >( stats_.peak_buffered, spikes.size() );
+#endif
+
+  // Spikes handled before the next update() were emitted at most two slices
+  // after the start of this one. This only reallocates when the histogram
+  // doubles.
+  if ( V_.psth_steps > 0 )
+    grow_psth_( Now.get_steps() + 2 * V_.slice_steps );
+
+  // Under load shedding, only part of the buffered spikes is recorded.
+  // Spikes buffered before the switch to count-only are dropped here.
+  if ( S_.recording_decimation == 0 )
+    spikes.clear();
+  else if ( S_.recording_decimation > 1 )
+    decimate_records_( spikes, S_.recording_decimation );
+
+  // A single event is filled in from each record and passed to the device
+  // once per unit of multiplicity, as the device records one line per spike.
+  nest::SpikeEvent se;
+  se.set_receiver( *this );
+
+  if ( P_.binary_output or P_.stream_events )
+  {
+    // In binary and streaming mode, the records bypass the device. Binary
+    // records are collected in a large buffer that is written in one go,
+    // streamed records are appended to the columns read by get_status().
+    // Ordered records are collected per slice parity until the sibling on
+    // thread 0 merges them in the next slice.
+    std::vector< FlightRecord_ >& binary_records =
+        P_.ordered_output ? B_.ordered_records_[ slice % 2 ] : B_.binary_buffer_;
+    const size_t n_ordered = B_.ordered_records_[ slice % 2 ].size();
+    for ( typename std::vector< SpikeRecord_ >::const_iterator r = spikes.begin();
+          r != spikes.end();
+          ++r )
+    {
+      const double time = nest::Time( nest::Time::step( r->stamp ) ).get_ms() - r->offset;
+      if ( P_.binary_output )
+      {
+        const FlightRecord_ record = { r->sender_gid, time };
+        binary_records.insert( binary_records.end(), r->multiplicity, record );
+      }
+      if ( P_.stream_events )
+      {
+        B_.stream_senders_->insert( B_.stream_senders_->end(), r->multiplicity, r->sender_gid );
+        B_.stream_times_->insert( B_.stream_times_->end(), r->multiplicity, time );
+      }
+#ifdef SPIKE_DETECTOR_FUSE_STATS
+      stats_.bytes_recorded += r->multiplicity
+        * ( ( P_.binary_output ? sizeof( FlightRecord_ ) : 0 )
+            + ( P_.stream_events ? sizeof( long ) + sizeof( double ) : 0 ) );
+#endif
+    }
+    if ( P_.ordered_output )
+    {
+      // update() may be called more than once in a slice, so the new records
+      // are merged with the ones recorded earlier in the slice
+      std::vector< FlightRecord_ >& run = B_.ordered_records_[ slice % 2 ];
+      std::sort( run.begin() + n_ordered, run.end() );
+      std::inplace_merge( run.begin(), run.begin() + n_ordered, run.end() );
+    }
+    else if ( B_.binary_buffer_.size() >= BINARY_BUFFER_RECORDS )
+      write_binary_records_();
+    spikes.clear();
+  }
+
+  for ( typename std::vector< SpikeRecord_ >::const_iterator r = spikes.begin();
+        r != spikes.end();
+        ++r )
+  {
+    assert( r->multiplicity > 0 );
+
+    se.set_sender_gid( r->sender_gid );
+    se.set_stamp( nest::Time::step( r->stamp ) );
+    se.set_offset( r->offset );
+    se.set_weight( r->weight );
+    se.set_port( r->port );
+    for ( int i = 0; i < r->multiplicity; ++i )
+      device_.record_event( se );
+  }
+
+  // do not use swap here to clear, since we want to keep the reserved()
+  // memory for the next round
+  spikes.clear();
+
+  // On the first call in a new slice, fold the network-wide count of the
+  // previous slice into the danger trace. All threads have finished the
+  // previous slice, and all siblings read the same sums of the table, so
+  // they arrive at the same danger level. update() may be called more than
+  // once per slice if a simulation ends within a slice.
+  if ( slice != S_.slice )
+  {
+    if ( S_.slice >= 0 and slice == S_.slice + 1 )
+    {
+      if ( nest::kernel().mpi_manager.get_num_processes() == 1 )
+      {
+        const std::vector< double >& n_spikes = reduce_thread_counts_( S_.slice );
+        update_danger_( n_spikes );
+        if ( V_.history_slices > 0 and get_thread() == 0 )
+          record_history_( Now, n_spikes );
+        if ( B_.telemetry_.is_open() )
+          publish_telemetry_( Now, S_.slice, n_spikes );
+      }
+      else
+      {
+        // The sibling on thread 0 (the MPI master thread) sums the counts of
+        // the previous slice over all processes and publishes them. All
+        // siblings use them in the next slice, after the end-of-slice
+        // barrier, and thus use the counts of the slice before the previous
+        // one here.
+        if ( get_thread() == 0 )
+        {
+          sum_thread_counts_( S_.slice );
+          B_.mpi_buffer_ = B_.step_sum_;
+          nest::kernel().mpi_manager.communicate_Allreduce_sum_in_place( B_.mpi_buffer_ );
+
+          GlobalCount_& published = B_.global_counts_[ S_.slice % 2 ];
+          published.n_spikes.swap( B_.mpi_buffer_ );
+          published.slice = S_.slice;
+        }
+
+        const GlobalCount_& global = B_.shared_global_[ ( S_.slice + 1 ) % 2 ];
+        if ( global.slice == S_.slice - 1 )
+        {
+          // These counts belong to the slice that ended one slice before Now
+          const nest::Time global_end = nest::Time::step( Now.get_steps() - V_.slice_steps );
+          update_danger_( global.n_spikes );
+          if ( V_.history_slices > 0 and get_thread() == 0 )
+            record_history_( global_end, global.n_spikes );
+          if ( B_.telemetry_.is_open() )
+            publish_telemetry_( global_end, global.slice, global.n_spikes );
+        }
+      }
+    }
+
+    if ( not P_.shedding_levels.empty() )
+      update_shedding_tier_( Now );
+
+    // All siblings have finished the previous slice and do not touch its
+    // ordered records in this one
+    if ( P_.ordered_output and get_thread() == 0 )
+      merge_ordered_records_( ( slice + 1 ) % 2 );
+
+    // The row for this slice held the counts of two slices ago, which all
+    // siblings have read during the previous slice
+    S_.slice = slice;
+    std::fill( thread_row_( slice ), thread_row_( slice ) + V_.row_length, 0.0 );
+    std::copy( V_.n_local_senders.begin(), V_.n_local_senders.end(), thread_row_( slice ) + V_.senders_offset );
+
+    // Free the oldest flight recorder segment for the spikes delivered in
+    // the next slice. clear() keeps the memory of the segment.
+    if ( V_.flight_segments > 0 )
+      B_.flight_recorder_[ ( slice + 1 ) % V_.flight_segments ].clear();
+  }
+
+  // Move the per-step counts received for the previous slice to this
+  // sibling's row. Bins were filled by stamp modulo slice length, the
+  // previous slice started at step Now - slice_steps.
+  std::vector< double >& step_spikes = B_.step_spikes_[ read_toggle ];
+  double* const row = thread_row_( slice );
+  const long origin = Now.get_steps() - V_.slice_steps;
+  fuse_rotate_bins( &step_spikes[ 0 ], row, origin, V_.slice_steps, V_.n_channels );
+  if ( V_.weighted_bins )
+    fuse_rotate_bins( &step_spikes[ V_.weighted_offset ], row + V_.weighted_offset, origin, V_.slice_steps, V_.n_channels );
+  for ( size_t i = V_.extra_offset; i < V_.weighted_offset; ++i )
+  {
+    row[ i ] += step_spikes[ i ];
+    step_spikes[ i ] = 0.0;
+  }
+
+  // All siblings reach the same decision in the same slice. The trace may
+  // have crossed the threshold in any step of the slice it was advanced over.
+  if ( S_.fused )
+    return;
+
+  std::string detail;
+  const typename Core_::trip trip = check_fuse_( detail );
+  if ( trip == Core_::NO_TRIP )
+    return;
+
+  if ( V_.flight_segments > 0 )
+    dump_flight_recorder_();
+
+  if ( B_.telemetry_.is_open() )
+  {
+    fuse_telemetry_record* record = B_.telemetry_.begin_write();
+    record->fused = 1;
+    record->trip = trip;
+    B_.telemetry_.end_write();
+  }
+
+  if ( not P_.stop_on_trip )
+  {
+    if ( trip == Core_::QUIESCENT_NETWORK )
+      throw QuiescentNetwork( detail );
+    if ( trip == Core_::SYNCHRONOUS_SPIKING )
+      throw SynchronousSpiking( detail );
+    throw UnstableSpiking( detail );
+  }
+
+  // Soft stop: the simulation loop checks the signal flag of the interpreter
+  // at the end of every slice and then leaves Simulate as on an interrupt by
+  // the user, with all nodes updated up to the same time. Unlike terminate(),
+  // this leaves the kernel ready to simulate further. All processes trip in
+  // the same slice, so that all of them leave the loop together.
+  S_.fused = true;
+  S_.fused_at = Now.get_ms();
+  if ( trip == Core_::QUIESCENT_NETWORK )
+    S_.fuse_reason = QuiescentNetwork( detail ).message();
+  else if ( trip == Core_::SYNCHRONOUS_SPIKING )
+    S_.fuse_reason = SynchronousSpiking( detail ).message();
+  else
+    S_.fuse_reason = UnstableSpiking( detail ).message();
+  if ( get_thread() == 0 )
+  {
+    LOG( nest::M_WARNING,
+        "spike_detector_fuse::update",
+        String::compose( "%1 at %2 ms.", S_.fuse_reason, S_.fused_at ) );
+    SLIsignalflag = SOFT_STOP_SIGNAL;
+  }
+}
+
+template < typename TKernel >
+typename mynest::fuse_core< TKernel >::trip
+mynest::basic_spike_detector_fuse< TKernel >::check_fuse_( std::string& detail ) const
+{
+  size_t channel = 0;
+  const typename Core_::trip trip = core_.check( channel );
+  if ( trip != Core_::NO_TRIP )
+  {
+    detail = P_.channels.empty() ? std::string() : " in channel '" + P_.channels[ channel ].name + "'";
+    if ( trip == Core_::PREDICTED_UNSTABLE_SPIKING )
+      detail += String::compose( ": danger level predicted to exceed 1 in %1 ms, within the horizon of %2 ms",
+        core_.time_to_threshold()[ channel ],
+        P_.predict_horizon );
+    if ( trip == Core_::SYNCHRONOUS_SPIKING )
+      detail += String::compose( ": Fano factor %1 above %2 for %3 ms",
+        core_.fano_factor( channel ),
+        P_.synchrony_thresh,
+        P_.synchrony_length );
+    return trip;
+  }
+
+  if ( P_.neuron_trip and S_.n_runaway_senders > 0 )
+  {
+    detail = ": " + numberToString( S_.n_runaway_senders ) + " neuron(s) exceeded neuron_rate_thresh";
+    return Core_::UNSTABLE_SPIKING;
+  }
+
+  return Core_::NO_TRIP;
+}
+
+template < typename TKernel >
+std::string
+mynest::basic_spike_detector_fuse< TKernel >::build_filename_( const std::string& extension ) const
+{
+  const std::string& path = nest::kernel().io_manager.get_data_path();
+  return String::compose( "%1%2%3-%4-%5.%6",
+    path.empty() ? "" : path + "/",
+    nest::kernel().io_manager.get_data_prefix(),
+    get_name(),
+    get_gid(),
+    get_vp(),
+    extension );
+}
+
+template < typename TKernel >
+bool
+mynest::basic_spike_detector_fuse< TKernel >::may_write_file_( const std::string& filename ) const
+{
+  if ( nest::kernel().io_manager.overwrite_files() )
+    return true;
+
+  std::ifstream test( filename.c_str() );
+  if ( not test.good() )
+    return true;
+
+  LOG( nest::M_ERROR,
+    "spike_detector_fuse::may_write_file_",
+    String::compose( "The device file '%1' exists already and will not be overwritten. Please change data_path, "
+                     "data_prefix or label, or set /overwrite_files to true in the root node.",
+      filename ) );
+  return false;
+}
+
+template < typename TKernel >
+typename mynest::basic_spike_detector_fuse< TKernel >::FileHeader_
+mynest::basic_spike_detector_fuse< TKernel >::make_file_header_( const uint64_t n_records ) const
+{
+  const FileHeader_ header = { { 'S', 'D', 'F', 'U', 'S', 'E', '\0', '\0' },
+                               FILE_FORMAT_VERSION,
+                               sizeof( FlightRecord_ ),
+                               get_gid(),
+                               static_cast< uint32_t >( get_vp() ),
+                               0,
+                               n_records };
+  return header;
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::open_binary_file_()
+{
+  const std::string filename = build_filename_( "spikes" );
+  if ( not may_write_file_( filename ) )
+    throw nest::IOError();
+  B_.binary_file_.open( filename.c_str(), std::ios::binary | std::ios::trunc );
+  if ( not B_.binary_file_.good() )
+  {
+    B_.binary_file_.close();
+    throw nest::IOError();
+  }
+
+  // The number of records is filled in by write_binary_records_()
+  const FileHeader_ header = make_file_header_( 0 );
+  B_.binary_file_.write( reinterpret_cast< const char* >( &header ), sizeof( header ) );
+  B_.n_binary_records_ = 0;
+  B_.binary_buffer_.reserve( BINARY_BUFFER_RECORDS );
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::write_binary_records_()
+{
+  if ( not B_.binary_file_.is_open() )
+    return;
+
+  if ( not B_.binary_buffer_.empty() )
+  {
+    B_.binary_file_.write( reinterpret_cast< const char* >( &B_.binary_buffer_[ 0 ] ),
+      B_.binary_buffer_.size() * sizeof( FlightRecord_ ) );
+    B_.n_binary_records_ += B_.binary_buffer_.size();
+    B_.binary_buffer_.clear();
+  }
+
+  // Keep the header up to date, so that the file is complete after every
+  // call to Simulate
+  const std::streampos end = B_.binary_file_.tellp();
+  B_.binary_file_.seekp( offsetof( FileHeader_, n_records ) );
+  B_.binary_file_.write( reinterpret_cast< const char* >( &B_.n_binary_records_ ), sizeof( uint64_t ) );
+  B_.binary_file_.seekp( end );
+  B_.binary_file_.flush();
+
+  if ( not B_.binary_file_.good() )
+    throw nest::IOError();
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::merge_ordered_records_( const long parity )
+{
+  const nest::SiblingContainer* siblings = nest::kernel().node_manager.get_thread_siblings( get_gid() );
+  std::vector< OrderedRun_ > runs;
+  for ( std::vector< nest::Node* >::const_iterator sibling = siblings->begin(); sibling != siblings->end();
+        ++sibling )
+  {
+    const std::vector< FlightRecord_ >& records =
+        downcast< basic_spike_detector_fuse >( **sibling ).B_.ordered_records_[ parity ];
+    if ( not records.empty() )
+    {
+      const OrderedRun_ run = { &records[ 0 ], &records[ 0 ] + records.size() };
+      runs.push_back( run );
+    }
+  }
+
+  // k-way merge over a heap of the runs, with the earliest record on top
+  std::make_heap( runs.begin(), runs.end() );
+  while ( not runs.empty() )
+  {
+    std::pop_heap( runs.begin(), runs.end() );
+    OrderedRun_& run = runs.back();
+    B_.binary_buffer_.push_back( *run.next );
+    if ( B_.binary_buffer_.size() >= BINARY_BUFFER_RECORDS )
+      write_binary_records_();
+    if ( ++run.next == run.end )
+      runs.pop_back();
+    else
+      std::push_heap( runs.begin(), runs.end() );
+  }
+
+  for ( std::vector< nest::Node* >::const_iterator sibling = siblings->begin(); sibling != siblings->end();
+        ++sibling )
+    downcast< basic_spike_detector_fuse >( **sibling ).B_.ordered_records_[ parity ].clear();
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::finalize()
+{
+  // With ordered_output, the file of the sibling on thread 0 is written by
+  // the last sibling to finish, which need not be the one on thread 0
+  if ( P_.ordered_output )
+    finalize_ordered_output_();
+  else
+    write_binary_records_();
+  device_.finalize();
+
+  // Clear a soft stop, but not an interrupt by the user that came after it
+  if ( get_thread() == 0 and SLIsignalflag == SOFT_STOP_SIGNAL )
+    SLIsignalflag = 0;
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::finalize_ordered_output_()
+{
+  // Siblings are finalized concurrently, so the last one to finish merges
+  // the records that update() on thread 0 has not merged yet, i.e. those of
+  // the last slice and possibly of the one before
+  const nest::SiblingContainer* siblings = nest::kernel().node_manager.get_thread_siblings( get_gid() );
+  basic_spike_detector_fuse& root = downcast< basic_spike_detector_fuse >( **siblings->begin() );
+  bool last;
+#pragma omp critical( spike_detector_fuse_ordered_output )
+  {
+    last = ++root.B_.n_finalized_ == static_cast< long >( siblings->num_thread_siblings() );
+    if ( last )
+      root.B_.n_finalized_ = 0;
+  }
+
+  if ( last )
+  {
+    if ( root.S_.slice >= 0 )
+    {
+      root.merge_ordered_records_( ( root.S_.slice + 1 ) % 2 );
+      root.merge_ordered_records_( root.S_.slice % 2 );
+    }
+    root.write_binary_records_();
+  }
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::dump_flight_recorder_() const
+{
+  if ( B_.flight_recorder_.empty() )
+    return;
+
+  // Errors are only logged, so that they do not replace the exception of a
+  // trip
+  const std::string filename = build_filename_( "flight" );
+  if ( not may_write_file_( filename ) )
+    return;
+
+  std::ofstream file( filename.c_str(), std::ios::binary | std::ios::trunc );
+  if ( not file.good() )
+  {
+    LOG( nest::M_ERROR,
+      "spike_detector_fuse::dump_flight_recorder_",
+      String::compose( "Could not open %1 for writing.", filename ) );
+    return;
+  }
+
+  // The oldest segment follows the one of the current slice
+  const size_t n_segments = B_.flight_recorder_.size();
+  const size_t newest = S_.slice >= 0 ? S_.slice % n_segments : 0;
+  uint64_t n_records = 0;
+  for ( size_t i = 0; i < n_segments; ++i )
+    n_records += B_.flight_recorder_[ i ].size();
+
+  const FileHeader_ header = make_file_header_( n_records );
+  file.write( reinterpret_cast< const char* >( &header ), sizeof( header ) );
+  for ( size_t i = 1; i <= n_segments; ++i )
+  {
+    const std::vector< FlightRecord_ >& segment = B_.flight_recorder_[ ( newest + i ) % n_segments ];
+    if ( not segment.empty() )
+      file.write( reinterpret_cast< const char* >( &segment[ 0 ] ), segment.size() * sizeof( FlightRecord_ ) );
+  }
+
+  if ( not file.good() )
+    LOG( nest::M_ERROR,
+      "spike_detector_fuse::dump_flight_recorder_",
+      String::compose( "Could not write %1.", filename ) );
+  else
+    LOG( nest::M_INFO,
+      "spike_detector_fuse::dump_flight_recorder_",
+      String::compose( "Wrote %1 spikes to %2.", n_records, filename ) );
+}
+
+template < typename TKernel >
+double*
+mynest::basic_spike_detector_fuse< TKernel >::thread_row_( const long slice )
+{
+  return &( *B_.shared_ )[ ( 2 * get_thread() + slice % 2 ) * V_.row_stride ];
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::sum_thread_counts_( const long slice )
+{
+  sum_count_rows( *B_.shared_, V_.row_stride, V_.row_length, slice, B_.step_sum_ );
+}
+
+template < typename TKernel >
+const std::vector< double >&
+mynest::basic_spike_detector_fuse< TKernel >::reduce_thread_counts_( const long slice )
+{
+  // The sums of a parity are overwritten two slices later, after the barrier
+  // at the end of the slice in which all siblings have read them
+  GlobalCount_& published = B_.shared_global_[ slice % 2 ];
+#pragma omp critical( spike_detector_fuse_thread_counts )
+  {
+    if ( published.slice != slice )
+    {
+      sum_count_rows( *B_.shared_, V_.row_stride, V_.row_length, slice, published.n_spikes );
+      published.slice = slice;
+    }
+  }
+  return published.n_spikes;
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::calibrate_channel_( const size_t c, const double n_neurons )
+{
+  const Channel_& ch = V_.channels[ c ];
+  V_.n_neurons[ c ] = n_neurons;
+  core_.calibrate_channel( c,
+    ch.frequency_thresh,
+    ch.length_thresh,
+    ch.quiescence_thresh,
+    ch.quiescence_length,
+    n_neurons,
+    V_.step_ms,
+    V_.slice_steps );
+  if ( n_neurons > 0 and ch.length_thresh > 0 and ch.frequency_thresh > 0 )
+    V_.offset_decay_rate[ c ] = core_.offset_decay_rate( c, V_.step_ms );
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::update_danger_( const std::vector< double >& n_spikes )
+{
+  const size_t n_channels = V_.n_channels;
+
+  // Channels without a given number of neurons follow the number of senders
+  // connected on all threads and processes
+  for ( size_t c = 0; c < n_channels; ++c )
+    if ( V_.channels[ c ].n_connected_neurons == 0 and n_spikes[ V_.senders_offset + c ] != V_.n_neurons[ c ] )
+      calibrate_channel_( c, n_spikes[ V_.senders_offset + c ] );
+
+  core_.advance( &n_spikes[ 0 ], &n_spikes[ V_.weighted_bins ? V_.weighted_offset : 0 ], V_.slice_steps );
+
+  S_.n_runaway_senders += n_spikes[ V_.extra_offset + RUNAWAY_SENDERS_BIN ];
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::grow_psth_( const long steps )
+{
+  const size_t n_bins = ( steps + V_.psth_steps - 1 ) / V_.psth_steps;
+  if ( B_.psth_.size() < n_bins * V_.n_channels )
+    B_.psth_.resize( std::max( n_bins * V_.n_channels, 2 * B_.psth_.size() ), 0.0 );
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::update_shedding_tier_( nest::Time const& Now )
+{
+  // The danger levels are identical on all siblings, so all of them switch in
+  // the same slice
+  const std::vector< double >& danger_level = core_.danger_level();
+  const double danger = danger_level.empty() ? 0.0 : *std::max_element( danger_level.begin(), danger_level.end() );
+  const long n_tiers = P_.shedding_levels.size();
+
+  long tier = S_.shedding_tier;
+  while ( tier < n_tiers and danger >= P_.shedding_levels[ tier ] )
+    ++tier;
+  while ( tier > 0 and danger < P_.shedding_levels[ tier - 1 ] - P_.shedding_hysteresis )
+    --tier;
+  if ( tier == S_.shedding_tier )
+    return;
+
+  S_.shedding_tier = tier;
+  S_.recording_decimation = 1;
+  for ( long k = 0; k < tier; ++k )
+    S_.recording_decimation *= P_.shedding_decimation;
+  if ( tier == n_tiers )
+    S_.recording_decimation = 0;
+
+  if ( get_thread() == 0 )
+  {
+    B_.shedding_times_.push_back( Now.get_ms() );
+    B_.shedding_tiers_.push_back( tier );
+
+    std::string recording;
+    if ( S_.recording_decimation == 0 )
+      recording = "counting spikes only";
+    else if ( S_.recording_decimation == 1 )
+      recording = "recording all spikes";
+    else
+      recording = String::compose( "recording every %1th spike", S_.recording_decimation );
+    LOG( nest::M_WARNING,
+      "spike_detector_fuse::update",
+      String::compose( "GID %1: danger level %2 at %3 ms, switched to load shedding tier %4, %5.",
+        get_gid(),
+        danger,
+        Now.get_ms(),
+        tier,
+        recording ) );
+  }
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::decimate_records_( std::vector< SpikeRecord_ >& spikes,
+  const long decimation )
+{
+  // Records are compacted in place, keeping the number of their spikes that
+  // fall on a multiple of decimation in the running count
+  typename std::vector< SpikeRecord_ >::iterator kept = spikes.begin();
+  for ( typename std::vector< SpikeRecord_ >::iterator r = spikes.begin(); r != spikes.end(); ++r )
+  {
+    const long before = B_.n_decimated_;
+    B_.n_decimated_ += r->multiplicity;
+    const long n_kept = B_.n_decimated_ / decimation - before / decimation;
+    if ( n_kept > 0 )
+    {
+      *kept = *r;
+      kept->multiplicity = n_kept;
+      ++kept;
+    }
+  }
+  spikes.erase( kept, spikes.end() );
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::publish_telemetry_( nest::Time const& slice_end,
+  const long slice,
+  const std::vector< double >& n_spikes )
+{
+  const double slice_s = V_.slice_steps * V_.step_ms * 1e-3;
+  fuse_telemetry_record* record = B_.telemetry_.begin_write();
+  record->slice = slice;
+  record->time = slice_end.get_ms();
+  record->fused = S_.fused;
+  if ( not S_.fused )
+    record->trip = Core_::NO_TRIP;
+  for ( size_t c = 0; c < record->n_channels; ++c )
+  {
+    double count = 0.0;
+    for ( long k = 0; k < V_.slice_steps; ++k )
+      count += n_spikes[ k * V_.n_channels + c ];
+    record->danger_level[ c ] = core_.danger_level()[ c ];
+    record->n_spikes[ c ] = count;
+    record->rate[ c ] = V_.n_neurons[ c ] > 0 ? count / ( V_.n_neurons[ c ] * slice_s ) : 0.0;
+  }
+  B_.telemetry_.end_write();
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::record_history_( nest::Time const& slice_end,
+  const std::vector< double >& n_spikes )
+{
+  // Over the slices of an interval, the highest danger level and the total
+  // number of spikes are kept per channel
+  for ( long k = 0; k < V_.slice_steps; ++k )
+    for ( size_t c = 0; c < V_.n_channels; ++c )
+      B_.history_window_spikes_[ c ] += n_spikes[ k * V_.n_channels + c ];
+  for ( size_t c = 0; c < V_.n_channels; ++c )
+    B_.history_window_danger_[ c ] = std::max( B_.history_window_danger_[ c ], core_.danger_level()[ c ] );
+
+  if ( ++B_.history_window_slices_ < V_.history_slices )
+    return;
+
+  const size_t entry = B_.history_next_;
+  B_.history_times_[ entry ] = slice_end.get_ms();
+  std::copy( B_.history_window_danger_.begin(),
+    B_.history_window_danger_.end(),
+    B_.history_danger_.begin() + entry * V_.n_channels );
+  std::copy( B_.history_window_spikes_.begin(),
+    B_.history_window_spikes_.end(),
+    B_.history_spikes_.begin() + entry * V_.n_channels );
+
+  B_.history_next_ = ( entry + 1 ) % B_.history_times_.size();
+  B_.history_count_ = std::min( B_.history_count_ + 1, B_.history_times_.size() );
+  std::fill( B_.history_window_danger_.begin(), B_.history_window_danger_.end(), 0.0 );
+  std::fill( B_.history_window_spikes_.begin(), B_.history_window_spikes_.end(), 0.0 );
+  B_.history_window_slices_ = 0;
+}
+
+template < typename TKernel >
+size_t
+mynest::basic_spike_detector_fuse< TKernel >::channel_of_( const nest::index sender_gid ) const
+{
+  return find_channel( V_.gid_ranges, sender_gid, V_.n_channels );
+}
+
+template < typename TKernel >
+bool
+mynest::basic_spike_detector_fuse< TKernel >::update_sender_trace_( const nest::index sender_gid,
+  const long step,
+  const int multiplicity )
+{
+  std::vector< SenderTrace_ >& table = B_.sender_traces_;
+
+  // The slot is taken from a full mix of the GID, since the low bits of a
+  // multiplicative hash repeat for GIDs that are a power of two apart
+  const uint32_t gid = static_cast< uint32_t >( sender_gid );
+  const size_t mask = table.size() - 1;
+  size_t i = fuse_gid_sampler::hash( gid ) & mask;
+  while ( table[ i ].gid != 0 and table[ i ].gid != gid )
+    i = ( i + 1 ) & mask;
+
+  SenderTrace_& entry = table[ i ];
+  if ( entry.gid == 0 )
+  {
+    // calibrate() sized the table for all connected senders. A sender that
+    // was not connected then is not traced rather than growing the table.
+    if ( 2 * ( B_.n_sender_traces_ + 1 ) > table.size() )
+      return false;
+    entry.gid = gid;
+    entry.trace = 0.0f;
+    entry.last_step = static_cast< uint32_t >( step );
+    ++B_.n_sender_traces_;
+  }
+
+  // The trace is stored negative once the sender has been reported, so that
+  // every sender is reported only once. Spikes of a slice may arrive out of
+  // order, an earlier spike is added without decay.
+  const bool reported = entry.trace < 0.0f;
+  double trace = reported ? -entry.trace : entry.trace;
+  const int32_t elapsed = static_cast< int32_t >( static_cast< uint32_t >( step ) - entry.last_step );
+  if ( elapsed > 0 )
+  {
+    trace *= std::exp( V_.neuron_decay_rate * elapsed );
+    entry.last_step = static_cast< uint32_t >( step );
+  }
+  trace += V_.neuron_increment_step * multiplicity;
+
+  const bool crossed = not reported and trace > 1.0;
+  entry.trace = ( reported or crossed ) ? -static_cast< float >( trace ) : static_cast< float >( trace );
+  return crossed;
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::get_status( DictionaryDatum& d ) const
+{
+  P_.get(d);
+  S_.get(d);
+  ( *d )[ "danger_level" ] = DoubleVectorDatum( new std::vector< double >( core_.danger_level() ) );
+  ( *d )[ "time_to_threshold" ] = DoubleVectorDatum( new std::vector< double >( core_.time_to_threshold() ) );
+  std::vector< double >* fano_factor = new std::vector< double >( core_.n_channels() );
+  std::vector< double >* peak_to_mean = new std::vector< double >( core_.n_channels() );
+  for ( size_t c = 0; c < core_.n_channels(); ++c )
+  {
+    ( *fano_factor )[ c ] = core_.fano_factor( c );
+    ( *peak_to_mean )[ c ] = core_.peak_to_mean( c );
+  }
+  ( *d )[ "fano_factor" ] = DoubleVectorDatum( fano_factor );
+  ( *d )[ "peak_to_mean" ] = DoubleVectorDatum( peak_to_mean );
+
+  // get the data from the device
+  device_.get_status( d );
+
+  // if we are the device on thread 0, also get the data from the
+  // siblings on other threads
+  if ( local_receiver_ && get_thread() == 0 )
+  {
+    const nest::SiblingContainer* siblings =
+        nest::kernel().node_manager.get_thread_siblings( get_gid() );
+    std::vector< nest::Node* >::const_iterator sibling;
+    for ( sibling = siblings->begin() + 1; sibling != siblings->end();
+          ++sibling )
+      ( *sibling )->get_status( d );
+
+    // Senders are handled on a single thread, so the lists of the siblings
+    // are disjoint
+    std::vector< long >* runaway_senders = new std::vector< long >();
+    for ( sibling = siblings->begin(); sibling != siblings->end(); ++sibling )
+    {
+      const basic_spike_detector_fuse& sd = downcast< basic_spike_detector_fuse >( **sibling );
+      runaway_senders->insert(
+          runaway_senders->end(), sd.B_.runaway_senders_.begin(), sd.B_.runaway_senders_.end() );
+    }
+    std::sort( runaway_senders->begin(), runaway_senders->end() );
+    ( *d )[ "runaway_senders" ] = IntVectorDatum( runaway_senders );
+
+    // Each sender is connected to the sibling on its own thread only
+    long n_connected_senders = 0;
+    for ( sibling = siblings->begin(); sibling != siblings->end(); ++sibling )
+      n_connected_senders += downcast< basic_spike_detector_fuse >( **sibling ).connected_senders_.size();
+    def< long >( d, "n_connected_senders", n_connected_senders );
+
+    // The history ring is unrolled, oldest entry first
+    if ( B_.history_count_ > 0 )
+    {
+      const size_t size = B_.history_times_.size();
+      const size_t first = ( B_.history_next_ + size - B_.history_count_ ) % size;
+      std::vector< double >* times = new std::vector< double >();
+      std::vector< double >* danger = new std::vector< double >();
+      std::vector< double >* n_spikes = new std::vector< double >();
+      for ( size_t i = 0; i < B_.history_count_; ++i )
+      {
+        const size_t entry = ( first + i ) % size;
+        times->push_back( B_.history_times_[ entry ] );
+        danger->insert( danger->end(),
+          B_.history_danger_.begin() + entry * V_.n_channels,
+          B_.history_danger_.begin() + ( entry + 1 ) * V_.n_channels );
+        n_spikes->insert( n_spikes->end(),
+          B_.history_spikes_.begin() + entry * V_.n_channels,
+          B_.history_spikes_.begin() + ( entry + 1 ) * V_.n_channels );
+      }
+
+      DictionaryDatum history( new Dictionary );
+      ( *history )[ "times" ] = DoubleVectorDatum( times );
+      ( *history )[ "danger_level" ] = DoubleVectorDatum( danger );
+      ( *history )[ "n_spikes" ] = DoubleVectorDatum( n_spikes );
+      ( *d )[ "history" ] = history;
+    }
+
+    // The histograms of the siblings are summed up to the current time
+    if ( V_.psth_steps > 0 )
+    {
+      const size_t n_bins =
+          ( nest::kernel().simulation_manager.get_time().get_steps() + V_.psth_steps - 1 ) / V_.psth_steps;
+      std::vector< double >* times = new std::vector< double >( n_bins );
+      std::vector< double >* counts = new std::vector< double >( n_bins * V_.n_channels, 0.0 );
+      for ( size_t i = 0; i < n_bins; ++i )
+        ( *times )[ i ] = i * V_.psth_steps * V_.step_ms;
+      for ( sibling = siblings->begin(); sibling != siblings->end(); ++sibling )
+      {
+        const std::vector< double >& psth = downcast< basic_spike_detector_fuse >( **sibling ).B_.psth_;
+        const size_t n = std::min( psth.size(), counts->size() );
+        for ( size_t i = 0; i < n; ++i )
+          ( *counts )[ i ] += psth[ i ];
+      }
+
+      DictionaryDatum psth( new Dictionary );
+      ( *psth )[ "times" ] = DoubleVectorDatum( times );
+      ( *psth )[ "counts" ] = DoubleVectorDatum( counts );
+      ( *d )[ "psth" ] = psth;
+    }
+
+    if ( not B_.shedding_times_.empty() or not P_.shedding_levels.empty() )
+    {
+      DictionaryDatum timeline( new Dictionary );
+      ( *timeline )[ "times" ] = DoubleVectorDatum( new std::vector< double >( B_.shedding_times_ ) );
+      ( *timeline )[ "tiers" ] = IntVectorDatum( new std::vector< long >( B_.shedding_tiers_ ) );
+      ( *d )[ "shedding_timeline" ] = timeline;
+    }
+
+    // The columns of each sibling are shared with the dictionary, not copied
+    if ( P_.stream_events )
+    {
+      ArrayDatum stream;
+      for ( sibling = siblings->begin(); sibling != siblings->end(); ++sibling )
+      {
+        const basic_spike_detector_fuse& sd = downcast< basic_spike_detector_fuse >( **sibling );
+        DictionaryDatum events( new Dictionary );
+        ( *events )[ "senders" ] = sd.B_.stream_senders_;
+        ( *events )[ "times" ] = sd.B_.stream_times_;
+        def< long >( events, "vp", sd.get_vp() );
+        stream.push_back( new DictionaryDatum( events ) );
+      }
+      ( *d )[ "stream" ] = stream;
+    }
+
+#ifdef SPIKE_DETECTOR_FUSE_STATS
+    FuseStats total;
+    for ( sibling = siblings->begin(); sibling != siblings->end(); ++sibling )
+    {
+      const FuseStats& stats = downcast< basic_spike_detector_fuse >( **sibling ).stats_;
+      total.spikes_handled += stats.spikes_handled;
+      total.events_buffered += stats.events_buffered;
+      total.peak_buffered = std::max( total.peak_buffered, stats.peak_buffered );
+      total.bytes_recorded += stats.bytes_recorded;
+      total.handle_cycles += stats.handle_cycles;
+      total.update_cycles += stats.update_cycles;
+    }
+    DictionaryDatum stats( new Dictionary );
+    def< long >( stats, "spikes_handled", total.spikes_handled );
+    def< long >( stats, "events_buffered", total.events_buffered );
+    def< long >( stats, "peak_buffered", total.peak_buffered );
+    def< long >( stats, "bytes_recorded", total.bytes_recorded );
+    def< double >( stats, "handle_cycles", total.handle_cycles );
+    def< double >( stats, "update_cycles", total.update_cycles );
+    ( *d )[ "stats" ] = stats;
+#endif
+  }
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::set_status( const DictionaryDatum& d )
+{
+  Parameters_ Ptemp = P_;
+  Ptemp.set(d); // This is to ensure that parameterss are not illegally overridden in case of an exception
+  State_ Stemp = S_;
+  Stemp.set(d);
+  if ( S_.fused and not Stemp.fused )
+  {
+    // Senders reported before are marked in their traces, and are restarted
+    // as well, so that they are reported again
+    core_.reset();
+    const SenderTrace_ empty = { 0, 0.0f, 0 };
+    std::fill( B_.sender_traces_.begin(), B_.sender_traces_.end(), empty );
+    B_.n_sender_traces_ = 0;
+    B_.runaway_senders_.clear();
+  }
+  P_ = Ptemp;
+  S_ = Stemp;
+  device_.set_status( d );
+
+  // Drop the events the caller has consumed from this sibling's columns. The
+  // remaining events move to new columns, since the old ones may still be
+  // held by the caller.
+  std::vector< long > stream_consumed;
+  if ( updateValue< std::vector< long > >( d, "stream_consumed", stream_consumed ) )
+  {
+    const size_t n_siblings = nest::kernel().vp_manager.get_num_threads();
+    if ( stream_consumed.size() != n_siblings )
+      throw nest::BadParameter( "stream_consumed needs one count per entry of stream." );
+    const std::vector< long >& senders = *B_.stream_senders_;
+    const std::vector< double >& times = *B_.stream_times_;
+    const long n_consumed = stream_consumed[ get_thread() ];
+    if ( n_consumed < 0 or n_consumed > static_cast< long >( senders.size() ) )
+      throw nest::BadParameter( "stream_consumed must not exceed the number of streamed events." );
+    if ( n_consumed > 0 )
+    {
+      std::vector< long >* new_senders = new std::vector< long >();
+      std::vector< double >* new_times = new std::vector< double >();
+      if ( not P_.release_consumed )
+      {
+        new_senders->reserve( senders.capacity() );
+        new_times->reserve( times.capacity() );
+      }
+      new_senders->assign( senders.begin() + n_consumed, senders.end() );
+      new_times->assign( times.begin() + n_consumed, times.end() );
+      B_.stream_senders_ = IntVectorDatum( new_senders );
+      B_.stream_times_ = DoubleVectorDatum( new_times );
+    }
+  }
+
+  bool dump_flight_recorder = false;
+  updateValue< bool >( d, "dump_flight_recorder", dump_flight_recorder );
+  if ( dump_flight_recorder )
+    dump_flight_recorder_();
+
+#ifdef SPIKE_DETECTOR_FUSE_STATS
+  bool reset_stats = false;
+  updateValue< bool >( d, "reset_stats", reset_stats );
+  if ( reset_stats )
+    stats_.reset();
+#endif
+}
+
+template < typename TKernel >
+void
+mynest::basic_spike_detector_fuse< TKernel >::handle( nest::SpikeEvent& e )
+{
+#ifdef SPIKE_DETECTOR_FUSE_STATS
+  CycleTimer timer( stats_.handle_cycles );
+#endif
+
+  // accept spikes only if detector was active when spike was
+  // emitted
+  if ( device_.is_active( e.get_stamp() ) )
+  {
+    assert( e.get_multiplicity() > 0 );
+#ifdef SPIKE_DETECTOR_FUSE_STATS
+    stats_.spikes_handled += e.get_multiplicity();
+#endif
+
+    long dest_buffer;
+    if ( nest::kernel()
+        .modelrange_manager.get_model_of_gid( e.get_sender_gid() )
+        ->has_proxies() )
+      // events from central queue
+      dest_buffer = nest::kernel().event_delivery_manager.read_toggle();
+    else
+      // locally delivered events
+      dest_buffer = nest::kernel().event_delivery_manager.write_toggle();
+
+    // Bin the spike by the step in which it was emitted and the channel of
+    // its sender. For the danger trace, precise spikes are in addition
+    // weighted by its decay from the spike time to the end of that step.
+    const size_t channel = channel_of_( e.get_sender_gid() );
+    if ( channel < V_.n_channels )
+    {
+      const long step = e.get_stamp().get_steps() - 1;
+      const size_t bin = fuse_step_bin( step, V_.slice_steps, V_.n_channels, channel );
+      B_.step_spikes_[ dest_buffer ][ bin ] += e.get_multiplicity();
+      if ( V_.weighted_bins )
+        B_.step_spikes_[ dest_buffer ][ V_.weighted_offset + bin ] +=
+          e.get_multiplicity() * std::exp( V_.offset_decay_rate[ channel ] * e.get_offset() );
+    }
+
+    if ( V_.neuron_increment_step > 0
+      and update_sender_trace_( e.get_sender_gid(), e.get_stamp().get_steps(), e.get_multiplicity() ) )
+    {
+      B_.runaway_senders_.push_back( e.get_sender_gid() );
+      B_.step_spikes_[ dest_buffer ][ V_.extra_offset + RUNAWAY_SENDERS_BIN ] += 1.0;
+    }
+
+    // The flight recorder keeps recent spikes also in count_only mode
+    if ( V_.flight_segments > 0 )
+    {
+      const long slice = nest::kernel().simulation_manager.get_slice();
+      const FlightRecord_ record = { e.get_sender_gid(), e.get_stamp().get_ms() - e.get_offset() };
+      B_.flight_recorder_[ slice % V_.flight_segments ].insert(
+          B_.flight_recorder_[ slice % V_.flight_segments ].end(), e.get_multiplicity(), record );
+    }
+
+    // The histogram has been extended by calibrate() and update() to cover
+    // all spikes that can arrive before the next update(). A spike from
+    // outside that range is dropped rather than growing it here.
+    if ( V_.psth_steps > 0 and channel < V_.n_channels )
+    {
+      const size_t i = ( ( e.get_stamp().get_steps() - 1 ) / V_.psth_steps ) * V_.n_channels + channel;
+      if ( i < B_.psth_.size() )
+        B_.psth_[ i ] += e.get_multiplicity();
+    }
+
+    if ( P_.count_only or S_.recording_decimation == 0 or not V_.sampler.contains( e.get_sender_gid() ) )
+      return;
+
+    // Only the fields required for recording are stored, and the
+    // multiplicity is stored once rather than one record per spike
+    const SpikeRecord_ record = { e.get_sender_gid(),
+                                  e.get_stamp().get_steps(),
+                                  e.get_offset(),
+                                  e.get_weight(),
+                                  static_cast< int >( e.get_port() ),
+                                  static_cast< int >( e.get_multiplicity() ) };
+    B_.spikes_[ dest_buffer ].push_back( record );
+#ifdef SPIKE_DETECTOR_FUSE_STATS
+    ++stats_.events_buffered;
+#endif
+  }
+}
+
+#endif /* #ifndef SPIKE_DETECTOR_FUSE_IMPL_H */
@@ -0,0 +1,61 @@
+import glob
+
+import numpy as np
+
+HEADER_DTYPE = np.dtype([
+    ('magic', 'S8'),
+    ('version', '=u4'),
+    ('record_size', '=u4'),
+    ('device_gid', '=u8'),
+    ('vp', '=u4'),
+    ('reserved', '=u4'),
+    ('n_records', '=u8'),
+])
+
+RECORD_DTYPE = np.dtype([('senders', '=u8'), ('times', '=f8')])
+
+
+def read_header(filename):
+    '''
+    Return the header of a binary file written by spike_detector_fuse as a
+    numpy record with the fields of HEADER_DTYPE.
+    '''
+    header = np.fromfile(filename, dtype=HEADER_DTYPE, count=1)
+    if header.size != 1 or header['magic'][0] != b'SDFUSE':
+        raise ValueError("{} is not a spike_detector_fuse file".format(filename))
+    if header['record_size'][0] != RECORD_DTYPE.itemsize:
+        # The files are written in the byte order of the simulating machine
+        if header['record_size'][0].byteswap() == RECORD_DTYPE.itemsize:
+            raise ValueError("{} was written with the other byte order".format(filename))
+        raise ValueError("{} has an unsupported record size".format(filename))
+    return header[0]
+
+
+def load(filename):
+    '''
+    Map the records of a binary file written by spike_detector_fuse
+    (binary_output or flight recorder) into memory without copying them.
+
+    Returns a structured numpy array with the fields 'senders' and 'times',
+    e.g. load(f)['times'] is a view on the spike times of the file. The
+    records are interleaved in the file, so the view is strided, not a
+    contiguous column.
+    '''
+    header = read_header(filename)
+    if header['n_records'] == 0:
+        return np.zeros(0, dtype=RECORD_DTYPE)
+    return np.memmap(filename, dtype=RECORD_DTYPE, mode='r',
+                     offset=HEADER_DTYPE.itemsize, shape=(int(header['n_records']),))
+
+
+def load_all(pattern):
+    '''
+    Load all files matching the glob pattern, e.g. the files of all virtual
+    processes 'spike_detector_fuse-501-*.spikes', and return them in one
+    array sorted by time. This copies the records.
+    '''
+    parts = [load(f) for f in sorted(glob.glob(pattern))]
+    if not parts:
+        return np.zeros(0, dtype=RECORD_DTYPE)
+    records = np.concatenate(parts)
+    return records[np.argsort(records['times'], kind='stable')]
@@ -84,5 +84,7 @@ void mynest::SpikeDetFuseModule::init( SLIInterpreter* i )
      Return value is a handle for later unregistration.
   */
   nest::kernel().model_manager.register_node_model<mynest::spike_detector_fuse>("spike_detector_fuse");
+  nest::kernel().model_manager.register_node_model<mynest::spike_detector_fuse_boxcar>("spike_detector_fuse_boxcar");
+  nest::kernel().model_manager.register_node_model<mynest::spike_detector_fuse_cusum>("spike_detector_fuse_cusum");
 
 }  // SpikeDetFuseModule::init()
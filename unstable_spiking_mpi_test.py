@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""
+Checks that the fuse trips in the same slice on all MPI processes, and one slice after the danger
+level crossed the threshold when there is more than one process.
+
+Run with e.g.
+
+    mpirun -np 4 python3 unstable_spiking_mpi_test.py
+
+All input spikes are sent to neurons on a single virtual process, so the ranks that do not host
+these neurons receive no spikes at all and can only trip through the global spike count.
+"""
+import nest
+
+from stdout_redirector import stdout_discarded
+
+nest.Install('spikedetfusemodule')
+
+N_src = 800
+rate = 100.  # Hz
+freq_thresh = 20.  # Hz
+length_thresh = 100.  # ms
+
+
+def build_network(params):
+    with stdout_discarded():
+        nest.ResetKernel()
+        nest.SetKernelStatus({'total_num_virtual_procs': 2 * nest.NumProcesses()})
+
+    n_vps = nest.GetKernelStatus('total_num_virtual_procs')
+    spike_gen = nest.Create('poisson_generator', params={'rate': rate * n_vps})
+    parrot_neurons = nest.Create('parrot_neuron', N_src)
+    params.update({'frequency_thresh': freq_thresh, 'length_thresh': length_thresh, 'n_connected_neurons': N_src})
+    spike_det = nest.Create('spike_detector_fuse', params=params)
+
+    # Neurons are distributed round-robin over the virtual processes, so every n_vps-th neuron lives
+    # on the same virtual process
+    nest.Connect(spike_gen, parrot_neurons[::n_vps])
+    nest.Connect(parrot_neurons, spike_det)
+    return spike_det
+
+
+def all_equal(value):
+    try:
+        from mpi4py import MPI
+    except ImportError:
+        return True
+    return len(set(MPI.COMM_WORLD.allgather(value))) == 1
+
+
+build_network({})
+try:
+    with stdout_discarded():
+        nest.Simulate(500)
+except nest.NESTError as E:
+    if not E.args[0].startswith('UnstableSpiking'):
+        raise
+    t_trip = nest.GetKernelStatus('time')
+else:
+    raise RuntimeError("Test FAILED on rank {}. The Unstable Spiking was not caught".format(nest.Rank()))
+
+print("Rank {}: UNSTABLE at {:.4f} ms".format(nest.Rank(), t_trip))
+assert all_equal(t_trip), "Test FAILED. Ranks tripped at different times"
+
+# The history records the danger level at the end of every slice. With several processes, the
+# global count of a slice is only used one slice later, so the fuse trips one min_delay after
+# the first slice that ends above the threshold, in a single process at the end of that slice.
+min_delay = nest.GetKernelStatus('min_delay')
+spike_det = build_network({'fuse_action': 'stop', 'history_interval': min_delay, 'history_size': 10000})
+with stdout_discarded():
+    nest.Simulate(500)
+status = nest.GetStatus(spike_det)[0]
+assert status['fused'], "Test FAILED on rank {}. The fuse did not trip".format(nest.Rank())
+
+history = status['history']
+t_cross = min(t for t, level in zip(history['times'], history['danger_level']) if level > 1.)
+lag = min_delay if nest.NumProcesses() > 1 else 0.
+assert abs(status['fused_at'] - (t_cross + lag)) < 1e-9, \
+    "Test FAILED on rank {}. Tripped at {} ms, expected {} ms".format(nest.Rank(), status['fused_at'], t_cross + lag)
+assert all_equal(status['fused_at']), "Test FAILED. Ranks stopped at different times"
+print("Rank {}: crossed at {:.4f} ms, stopped at {:.4f} ms".format(nest.Rank(), t_cross, status['fused_at']))
+
+print("Rank {}: ALL TESTS PASSED SUCCESSFULLY".format(nest.Rank()))
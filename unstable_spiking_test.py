@@ -1,8 +1,10 @@
 #!/usr/bin/env python3
+import os
 import numpy as np
 import nest
 
 from stdout_redirector import stdout_discarded
+import spike_detector_fuse_reader
 
 nest.Install('spikedetfusemodule')
 
@@ -89,4 +91,493 @@ for i, (N_src,
             "Test FAILED. The Unstable Spiking was not caught even though rate > freq_thresh"
         print("  STABLE")
 
+
+# Helpers of the tests of the fuse features below
+
+# Parameters with which 100 parrot neurons driven at 100 Hz trip the fuse
+TRIP_PARAMS = {'frequency_thresh': 20.,
+               'length_thresh': 100.,
+               'n_connected_neurons': 100,
+               'count_only': True}
+
+
+def reset_kernel(vps=4, **kernel_status):
+    with stdout_discarded():
+        nest.ResetKernel()
+        nest.SetKernelStatus(dict({'total_num_virtual_procs': vps}, **kernel_status))
+
+
+def build_fused_network(params, rate, n_neurons=100, model='spike_detector_fuse', vps=4, spike_times=None,
+                        **kernel_status):
+    '''
+    Reset the kernel and connect n_neurons parrot neurons, driven by a common poisson_generator at rate Hz, or
+    by a spike_generator with the given spike_times, to a new device of the given model. Further keyword
+    arguments are set in the kernel. Returns the generator, the neurons and the device.
+    '''
+    reset_kernel(vps, **kernel_status)
+    if spike_times is None:
+        spike_gen = nest.Create('poisson_generator', params={'rate': rate})
+    else:
+        spike_gen = nest.Create('spike_generator', params={'spike_times': spike_times})
+    parrot_neurons = nest.Create('parrot_neuron', n_neurons)
+    spike_det = nest.Create(model, params=params)
+    nest.Connect(spike_gen, parrot_neurons)
+    nest.Connect(parrot_neurons, spike_det)
+    return spike_gen, parrot_neurons, spike_det
+
+
+def add_detector(neurons, params):
+    '''
+    Connect the neurons to another spike_detector_fuse with the given parameters and return it.
+    '''
+    spike_det = nest.Create('spike_detector_fuse', params=params)
+    nest.Connect(neurons, spike_det)
+    return spike_det
+
+
+def simulate(sim_time):
+    with stdout_discarded():
+        nest.Simulate(sim_time)
+
+
+def run_fuse(sim_time=500.):
+    '''
+    Simulate and return the message of the exception if a fuse tripped, or None if the simulation completed.
+    Other errors are passed on.
+    '''
+    try:
+        simulate(sim_time)
+    except nest.NESTError as E:
+        if not E.args[0].startswith(('UnstableSpiking', 'QuiescentNetwork', 'SynchronousSpiking')):
+            raise
+        print("  {} at {:.4f} ms".format(E.args[0].split()[0], nest.GetKernelStatus('time')))
+        return E.args[0]
+    return None
+
+
+def assert_raises(exception, sim_time=500., what=''):
+    '''
+    Simulate and check that NEST raises the given exception. Returns its message.
+    '''
+    try:
+        simulate(sim_time)
+    except nest.NESTError as E:
+        if not E.args[0].startswith(exception):
+            raise
+        return E.args[0]
+    raise RuntimeError("Test FAILED. {} was not raised{}".format(exception, what))
+
+
+def assert_trips(exception, sim_time=500., what=''):
+    '''
+    Simulate and check that the fuse trips with the given exception. Returns its message.
+    '''
+    message = assert_raises(exception, sim_time, what)
+    print("  {} at {:.4f} ms".format(exception, nest.GetKernelStatus('time')))
+    return message
+
+
+# In count_only mode the fuse must still trip, but no events may be recorded
+spike_gen, parrot_neurons, spike_det = build_fused_network(TRIP_PARAMS, 100.)
+
+print("")
+print("count_only run")
+assert_trips('UnstableSpiking', what=" in count_only mode")
+assert nest.GetStatus(spike_det, 'n_events')[0] == 0, "Test FAILED. Events were recorded in count_only mode"
+
+# With quiescence_thresh, a network that falls silent must trip, and an active one must not
+for rate, quiescent in [(0., True), (20., False)]:
+    spike_gen, parrot_neurons, spike_det = build_fused_network({'frequency_thresh': 100.,
+                                                                'length_thresh': 100.,
+                                                                'quiescence_thresh': 5.,
+                                                                'quiescence_length': 100.,
+                                                                'n_connected_neurons': 100,
+                                                                'count_only': True}, rate)
+
+    print("")
+    print("quiescence run at {} Hz".format(rate))
+    message = run_fuse(500)
+    if quiescent:
+        assert message is not None and message.startswith('QuiescentNetwork'), \
+            "Test FAILED. The silent network was not caught: {}".format(message)
+        assert nest.GetKernelStatus()['time'] < 500, "Test FAILED. Quiescence was caught too late"
+    else:
+        assert message is None, "Test FAILED. The active network tripped: {}".format(message)
+        print("  ACTIVE")
+
+# With channels, only the channel guarding the overactive population may trip
+reset_kernel()
+quiet_gen = nest.Create('poisson_generator', params={'rate': 5.})
+loud_gen = nest.Create('poisson_generator', params={'rate': 100.})
+quiet_neurons = nest.Create('parrot_neuron', 400)
+loud_neurons = nest.Create('parrot_neuron', 100)
+spike_det = nest.Create('spike_detector_fuse', params={
+    'frequency_thresh': 20.,
+    'length_thresh': 100.,
+    'count_only': True,
+    'channels': [{'name': 'quiet', 'gid_ranges': [quiet_neurons[0], quiet_neurons[-1]]},
+                 {'name': 'loud', 'gid_ranges': [loud_neurons[0], loud_neurons[-1]]}]})
+nest.Connect(quiet_gen, quiet_neurons)
+nest.Connect(loud_gen, loud_neurons)
+nest.Connect(quiet_neurons + loud_neurons, spike_det)
+
+print("")
+print("channels run")
+message = assert_trips('UnstableSpiking', what=" for channel 'loud'")
+assert "'loud'" in message, "Test FAILED. The wrong channel tripped: {}".format(message)
+
+# A few runaway neurons are found by their own traces while the population rate stays low. The
+# loud senders are a power of two apart, which must not make their hash slots collide.
+def build_runaway_network(params):
+    reset_kernel()
+    quiet_gen = nest.Create('poisson_generator', params={'rate': 10.})
+    loud_gen = nest.Create('poisson_generator', params={'rate': 1000.})
+    parrot_neurons = nest.Create('parrot_neuron', 200)
+    loud_neurons = parrot_neurons[::64]
+    spike_det = nest.Create('spike_detector_fuse', params=dict({'frequency_thresh': 100.,
+                                                                'length_thresh': 100.,
+                                                                'neuron_rate_thresh': 200.,
+                                                                'count_only': True}, **params))
+    nest.Connect(quiet_gen, [n for n in parrot_neurons if n not in loud_neurons])
+    nest.Connect(loud_gen, loud_neurons)
+    nest.Connect(parrot_neurons, spike_det)
+    return spike_det, loud_neurons
+
+print("")
+print("runaway neurons run")
+spike_det, loud_neurons = build_runaway_network({'neuron_action': 'report'})
+simulate(500)
+status = nest.GetStatus(spike_det)[0]
+assert sorted(status['runaway_senders']) == sorted(loud_neurons), \
+    "Test FAILED. Wrong runaway senders {}, expected {}".format(status['runaway_senders'], loud_neurons)
+assert status['n_runaway_senders'] == len(loud_neurons), \
+    "Test FAILED. n_runaway_senders is {}".format(status['n_runaway_senders'])
+print("  REPORTED {}".format(list(status['runaway_senders'])))
+
+spike_det, loud_neurons = build_runaway_network({})
+message = assert_trips('UnstableSpiking', what=" for the runaway neurons")
+assert 'neuron(s) exceeded' in message, "Test FAILED. Unexpected trip: {}".format(message)
+
+# With fuse_action 'stop', Simulate returns at the end of the slice in which the fuse trips, and the
+# simulation continues after it is rearmed
+spike_gen, parrot_neurons, spike_det = build_fused_network(dict(TRIP_PARAMS, fuse_action='stop'), 100.)
+
+print("")
+print("fuse_action 'stop' run")
+simulate(500.)
+status = nest.GetStatus(spike_det)[0]
+assert status['fused'], "Test FAILED. The fuse did not trip with fuse_action 'stop'"
+assert status['fuse_reason'].startswith('The Network seems to be in a regime of unstable spiking'), \
+    "Test FAILED. Unexpected fuse_reason: {}".format(status['fuse_reason'])
+stopped_at = nest.GetKernelStatus()['time']
+min_delay = nest.GetKernelStatus('min_delay')
+assert stopped_at < 500, "Test FAILED. Simulate did not stop early"
+assert stopped_at == status['fused_at'] + min_delay, \
+    "Test FAILED. Simulate stopped at {} ms, not at the end of the slice of the trip at {} ms".format(
+        stopped_at, status['fused_at'])
+print("  STOPPED at {:.4f} ms, tripped at {:.4f} ms".format(stopped_at, status['fused_at']))
+
+nest.SetStatus(spike_det, {'fused': False, 'fuse_action': 'abort'})
+nest.SetStatus(spike_gen, {'rate': 10.})
+simulate(100.)
+# The part of the stopped call that was not simulated is added to the next one
+assert nest.GetKernelStatus()['time'] >= stopped_at + 100., "Test FAILED. Simulate did not continue after a stop"
+assert not nest.GetStatus(spike_det, 'fused')[0], "Test FAILED. The rearmed fuse tripped again"
+print("  CONTINUED to {:.4f} ms".format(nest.GetKernelStatus()['time']))
+
+# Rearming also restarts the per-sender traces, so that runaway senders are reported again
+spike_det, loud_neurons = build_runaway_network({'fuse_action': 'stop'})
+simulate(500.)
+assert sorted(nest.GetStatus(spike_det, 'runaway_senders')[0]) == sorted(loud_neurons), \
+    "Test FAILED. The runaway senders were not reported before rearming"
+nest.SetStatus(spike_det, {'fused': False})
+simulate(500.)
+status = nest.GetStatus(spike_det)[0]
+assert status['fused'] and sorted(status['runaway_senders']) == sorted(loud_neurons), \
+    "Test FAILED. The runaway senders were not reported again after rearming: {}".format(status['runaway_senders'])
+print("  REPORTED the runaway senders again after rearming")
+
+# Binary output must contain the same spikes as the in-memory recording
+spike_gen, parrot_neurons, memory_det = build_fused_network({}, 20., overwrite_files=True)
+binary_det = add_detector(parrot_neurons, {'binary_output': True})
+
+print("")
+print("binary_output run")
+simulate(200)
+events = nest.GetStatus(memory_det, 'events')[0]
+records = spike_detector_fuse_reader.load_all(
+    '{}spike_detector_fuse-{}-*.spikes'.format(nest.GetKernelStatus('data_prefix'), binary_det[0]))
+assert len(records) == len(events['times']) > 0, "Test FAILED. Binary output lost spikes"
+assert np.allclose(np.sort(records['times']), np.sort(events['times'])), \
+    "Test FAILED. Binary output has wrong spike times"
+print("  {} spikes in binary output".format(len(records)))
+
+# The same files must not be replaced unless overwrite_files is set
+spike_gen, parrot_neurons, memory_det = build_fused_network({}, 20.)
+binary_det = add_detector(parrot_neurons, {'binary_output': True})
+assert_raises('IOError', 100, what=" for an existing binary output file")
+print("  existing binary output was not overwritten")
+
+# A trip writes the spikes of the last flight_recorder_length ms to the flight files
+spike_gen, parrot_neurons, spike_det = build_fused_network(dict(TRIP_PARAMS,
+                                                                count_only=False,
+                                                                flight_recorder_length=50.,
+                                                                fuse_action='stop'),
+                                                           100., overwrite_files=True)
+
+print("")
+print("flight_recorder_length run")
+simulate(300)
+status = nest.GetStatus(spike_det)[0]
+assert status['fused'], "Test FAILED. The fuse did not trip"
+records = spike_detector_fuse_reader.load_all(
+    '{}spike_detector_fuse-{}-*.flight'.format(nest.GetKernelStatus('data_prefix'), spike_det[0]))
+min_delay = nest.GetKernelStatus('min_delay')
+# The recorder keeps whole slices, and the slice of the trip may not be complete yet
+assert len(records) > 0, "Test FAILED. The flight files are empty"
+assert records['times'][-1] <= status['fused_at'] + 2 * min_delay, \
+    "Test FAILED. The flight files hold spikes after the trip"
+assert status['fused_at'] - 50. - 2 * min_delay <= records['times'][0] <= status['fused_at'] - 50. + min_delay, \
+    "Test FAILED. The flight files do not cover the last 50 ms: {} to {} ms, trip at {} ms".format(
+        records['times'][0], records['times'][-1], status['fused_at'])
+events = nest.GetStatus(spike_det, 'events')[0]
+window = (events['times'] > records['times'][0]) & (events['times'] <= status['fused_at'])
+assert np.sum(window) == np.sum((records['times'] > records['times'][0]) &
+                                (records['times'] <= status['fused_at'])), \
+    "Test FAILED. The flight files do not hold the recorded spikes"
+print("  {} spikes from {:.1f} to {:.1f} ms, tripped at {:.1f} ms".format(
+    len(records), records['times'][0], records['times'][-1], status['fused_at']))
+
+# With ordered_output, the spikes of all threads are merged into a single time-ordered file
+spike_gen, parrot_neurons, memory_det = build_fused_network({}, 20., overwrite_files=True)
+ordered_det = add_detector(parrot_neurons, {'binary_output': True, 'ordered_output': True})
+
+print("")
+print("ordered_output run")
+simulate(100)
+simulate(100)
+events = nest.GetStatus(memory_det, 'events')[0]
+# All threads write to the file of virtual process 0
+records = spike_detector_fuse_reader.load(
+    '{}spike_detector_fuse-{}-0.spikes'.format(nest.GetKernelStatus('data_prefix'), ordered_det[0]))
+assert len(records) == len(events['times']) > 0, "Test FAILED. Ordered output lost spikes"
+assert np.all(np.diff(records['times']) >= 0), "Test FAILED. Ordered output is not sorted by time"
+print("  {} spikes in time order".format(len(records)))
+
+# Any sibling may finish a call to Simulate last and write the ordered file, which must then be the same for any
+# number of threads. Many short calls give every sibling the chance to finish last.
+ordered_files = []
+for vps in (1, 3, 8):
+    spike_gen, parrot_neurons, ordered_det = build_fused_network(
+        {'binary_output': True, 'ordered_output': True}, 0., vps=vps,
+        spike_times=np.round(np.arange(1., 190., 1.7), 1).tolist(), overwrite_files=True)
+    for _ in range(20):
+        simulate(10)
+    filename = '{}spike_detector_fuse-{}-0.spikes'.format(nest.GetKernelStatus('data_prefix'), ordered_det[0])
+    records = np.array(spike_detector_fuse_reader.load(filename))
+    assert os.path.getsize(filename) == spike_detector_fuse_reader.HEADER_DTYPE.itemsize + records.nbytes, \
+        "Test FAILED. The ordered file with {} threads holds records beyond its header count".format(vps)
+    ordered_files.append(records)
+assert len(ordered_files[0]) > 0, "Test FAILED. Ordered output is empty"
+for vps, records in zip((3, 8), ordered_files[1:]):
+    assert np.array_equal(records, ordered_files[0]), \
+        "Test FAILED. Ordered output with {} threads differs from a single thread".format(vps)
+print("  {} spikes in the same order for 1, 3 and 8 threads".format(len(ordered_files[0])))
+
+# With telemetry_name, the state of the fuse is published in shared memory once per slice
+spike_gen, parrot_neurons, spike_det = build_fused_network({'frequency_thresh': 50.,
+                                                            'length_thresh': 100.,
+                                                            'count_only': True,
+                                                            'telemetry_name': '/sdfuse_test'}, 20.)
+simulate(100)
+
+# The leading fields of the record, see fuse_telemetry.h
+telemetry_dtype = np.dtype([('magic', 'S8'), ('version', 'u4'), ('n_channels', 'u4'), ('sequence', 'u8'),
+                            ('device_gid', 'u8'), ('slice', 'i8'), ('time', 'f8'), ('fused', 'u4'), ('trip', 'u4'),
+                            ('writer_pid', 'i4'), ('reserved', 'u4'), ('danger_level', 'f8', 16)])
+telemetry = np.fromfile('/dev/shm/sdfuse_test', dtype=telemetry_dtype, count=1)[0]
+
+print("")
+print("telemetry_name run")
+assert telemetry['magic'] == b'SDFTELE' and telemetry['device_gid'] == spike_det[0], \
+    "Test FAILED. The telemetry segment was not created"
+assert telemetry['sequence'] % 2 == 0 and telemetry['slice'] > 0 and telemetry['fused'] == 0, \
+    "Test FAILED. Unexpected telemetry record {}".format(telemetry)
+assert telemetry['danger_level'][0] == nest.GetStatus(spike_det, 'danger_level')[0][0], \
+    "Test FAILED. The telemetry does not match the danger level"
+# The last slice is folded in at the start of the next one
+assert np.isclose(telemetry['time'], nest.GetKernelStatus('time') - nest.GetKernelStatus('min_delay')), \
+    "Test FAILED. The telemetry time is not the end of its slice"
+assert telemetry['writer_pid'] == os.getpid(), "Test FAILED. Wrong telemetry writer"
+
+# A second device must not write to the same segment
+second_det = nest.Create('spike_detector_fuse', params={'count_only': True, 'telemetry_name': '/sdfuse_test'})
+assert_raises('IOError', 10, what=" for a second writer of the telemetry segment")
+print("  slice {} at {:.1f} ms, danger level {:.3f}".format(telemetry['slice'], telemetry['time'],
+                                                            telemetry['danger_level'][0]))
+
+# Streaming returns each event exactly once, in increments
+spike_gen, parrot_neurons, memory_det = build_fused_network({}, 20.)
+stream_det = add_detector(parrot_neurons, {'stream_events': True, 'release_consumed': True})
+
+print("")
+print("stream_events run")
+streamed_times = []
+for chunk in range(4):
+    simulate(50)
+    stream = nest.GetStatus(stream_det, 'stream')[0]
+    # Consume only half of the events of the first chunk, the rest must be
+    # reported again by the next poll
+    n_read = [len(events['times']) // 2 if chunk == 0 else len(events['times']) for events in stream]
+    for events, n in zip(stream, n_read):
+        streamed_times.extend(events['times'][:n])
+    nest.SetStatus(stream_det, {'stream_consumed': n_read})
+assert all(len(events['times']) == 0 for events in nest.GetStatus(stream_det, 'stream')[0]), \
+    "Test FAILED. Consumed events are streamed again"
+events = nest.GetStatus(memory_det, 'events')[0]
+assert np.allclose(np.sort(streamed_times), np.sort(events['times'])), \
+    "Test FAILED. Streamed events differ from recorded events"
+try:
+    nest.SetStatus(stream_det, {'stream_consumed': [1] * len(n_read)})
+    raise RuntimeError("Test FAILED. BadParameter was not raised for consuming more events than streamed")
+except nest.NESTError as E:
+    if not E.args[0].startswith('BadParameter'):
+        raise
+print("  {} spikes streamed".format(len(streamed_times)))
+
+# Neurons firing in synchrony trip the synchrony criterion, independent ones do not
+for synchronous in [False, True]:
+    spike_gen, parrot_neurons, spike_det = build_fused_network(
+        {'frequency_thresh': 100., 'length_thresh': 100., 'count_only': True, 'synchrony_thresh': 5.},
+        20., spike_times=np.arange(1., 500., 50.) if synchronous else None)
+
+    print("")
+    print("synchrony run, synchronous={}".format(synchronous))
+    if synchronous:
+        assert_trips('SynchronousSpiking', what=" for synchronous spiking")
+    else:
+        message = run_fuse(500)
+        assert message is None, "Test FAILED. Independent spiking tripped: {}".format(message)
+        print("  Fano factor {:.2f}".format(nest.GetStatus(spike_det, 'fano_factor')[0][0]))
+
+# With psth_bin, the spikes are binned in the device, also without recording them
+spike_gen, parrot_neurons, spike_det = build_fused_network({'frequency_thresh': 50.,
+                                                            'length_thresh': 100.,
+                                                            'psth_bin': 10.}, 20., 1000)
+simulate(500.)
+psth = nest.GetStatus(spike_det, 'psth')[0]
+events = nest.GetStatus(spike_det, 'events')[0]
+# A spike at time t was emitted in the step ending at t, so bins include their end but not their start
+expected, _ = np.histogram(events['times'], bins=np.arange(51) * 10. + 0.05)
+
+print("")
+print("psth_bin run")
+assert len(psth['times']) == 50, "Test FAILED. {} bins instead of 50".format(len(psth['times']))
+assert np.array_equal(psth['counts'], expected), "Test FAILED. The histogram does not match the recorded spikes"
+print("  {:.0f} spikes in {} bins".format(np.sum(psth['counts']), len(psth['counts'])))
+
+# With a stop time, the histogram is allocated once and holds no spikes after the stop
+spike_gen, parrot_neurons, spike_det = build_fused_network({'frequency_thresh': 50.,
+                                                            'length_thresh': 100.,
+                                                            'psth_bin': 10.,
+                                                            'stop': 300.}, 20., 1000)
+simulate(250.)
+simulate(250.)
+psth = nest.GetStatus(spike_det, 'psth')[0]
+events = nest.GetStatus(spike_det, 'events')[0]
+expected, _ = np.histogram(events['times'], bins=np.arange(51) * 10. + 0.05)
+assert len(psth['times']) == 50 and np.array_equal(psth['counts'], expected), \
+    "Test FAILED. The histogram with a stop time does not match the recorded spikes"
+assert np.sum(psth['counts'][30:]) == 0 < np.sum(psth['counts'][:30]), \
+    "Test FAILED. The histogram counted spikes after the stop time"
+print("  {:.0f} spikes before the stop time".format(np.sum(psth['counts'])))
+
+# With history_interval, every entry holds the spikes emitted in the interval that ends at its time
+spike_gen, parrot_neurons, spike_det = build_fused_network({'frequency_thresh': 50.,
+                                                            'length_thresh': 100.,
+                                                            'history_interval': 10.,
+                                                            'history_size': 15}, 20., 1000)
+simulate(200.)
+history = nest.GetStatus(spike_det, 'history')[0]
+events = nest.GetStatus(spike_det, 'events')[0]
+# The slice that ends with the run is folded into the traces in the next one
+n_entries = int(200. - nest.GetKernelStatus('min_delay')) // 10
+expected_times = np.arange(n_entries - 15, n_entries) * 10. + 10.
+expected, _ = np.histogram(events['times'], bins=np.append(expected_times[0] - 10., expected_times) + 0.05)
+
+print("")
+print("history_interval run")
+assert np.allclose(history['times'], expected_times), \
+    "Test FAILED. Unexpected history times {}".format(history['times'])
+assert np.array_equal(history['n_spikes'], expected), "Test FAILED. The history does not match the recorded spikes"
+assert np.all(np.array(history['danger_level']) > 0), "Test FAILED. The history has no danger levels"
+print("  {} entries from {:.0f} to {:.0f} ms".format(len(history['times']), history['times'][0],
+                                                      history['times'][-1]))
+
+# With sample_fraction, only the spikes of a fixed subset of the senders are recorded, for any number of threads
+sampled_senders = []
+for vps in [1, 4]:
+    spike_gen, parrot_neurons, spike_det = build_fused_network({'frequency_thresh': 50.,
+                                                                'length_thresh': 100.,
+                                                                'sample_fraction': 0.1}, 20., 1000, vps=vps)
+    simulate(500.)
+    sampled_senders.append(set(nest.GetStatus(spike_det, 'events')[0]['senders']))
+
+print("")
+print("sample_fraction run")
+assert sampled_senders[0] == sampled_senders[1], "Test FAILED. The sampled senders depend on the number of threads"
+assert 50 < len(sampled_senders[0]) < 150, "Test FAILED. {} senders sampled".format(len(sampled_senders[0]))
+print("  recorded {} of 1000 senders".format(len(sampled_senders[0])))
+
+# With shedding_levels, recording is reduced as the danger level rises
+spike_gen, parrot_neurons, spike_det = build_fused_network({'frequency_thresh': 50.,
+                                                            'length_thresh': 100.,
+                                                            'shedding_levels': [0.5, 0.9],
+                                                            'shedding_decimation': 10}, 40., 1000)
+simulate(500.)
+status = nest.GetStatus(spike_det)[0]
+timeline = status['shedding_timeline']
+n_spikes = 1000 * 40. * 0.5
+
+print("")
+print("shedding_levels run")
+assert list(timeline['tiers']) == [1], "Test FAILED. Unexpected shedding tiers: {}".format(timeline['tiers'])
+assert status['shedding_tier'] == 1, "Test FAILED. Unexpected shedding_tier {}".format(status['shedding_tier'])
+assert status['n_events'] < 0.5 * n_spikes, \
+    "Test FAILED. {} of {} spikes recorded while shedding".format(status['n_events'], n_spikes)
+print("  decimated from {:.4f} ms, recorded {} of {:.0f} spikes".format(timeline['times'][0], status['n_events'],
+                                                                       n_spikes))
+
+# With a predict_horizon, an exponentially growing rate trips the fuse earlier
+fused_at = {}
+for predict_horizon in [0., 20.]:
+    spike_gen, parrot_neurons, spike_det = build_fused_network({'frequency_thresh': 50.,
+                                                                'length_thresh': 100.,
+                                                                'count_only': True,
+                                                                'fuse_action': 'stop',
+                                                                'predict_horizon': predict_horizon}, 2., 1000)
+
+    rate = 2.
+    while not nest.GetStatus(spike_det, 'fused')[0] and nest.GetKernelStatus('time') < 1000.:
+        rate *= np.exp(5. / 20.)
+        nest.SetStatus(spike_gen, {'rate': rate})
+        simulate(5.)
+    status = nest.GetStatus(spike_det)[0]
+    assert status['fused'], "Test FAILED. The growing rate did not trip the fuse"
+    fused_at[predict_horizon] = status['fused_at']
+
+print("")
+print("predict_horizon run")
+assert 'horizon of 20' in status['fuse_reason'], "Test FAILED. Unexpected fuse_reason: {}".format(status['fuse_reason'])
+assert fused_at[20.] < fused_at[0.], "Test FAILED. The prediction did not trip earlier"
+print("  PREDICTED at {:.4f} ms instead of {:.4f} ms".format(fused_at[20.], fused_at[0.]))
+
+# All detection kernels must trip on the same overactive population
+for model in ['spike_detector_fuse_boxcar', 'spike_detector_fuse_cusum']:
+    spike_gen, parrot_neurons, spike_det = build_fused_network(TRIP_PARAMS, 100., model=model)
+
+    print("")
+    print("{} run".format(model))
+    assert_trips('UnstableSpiking', what=" by {}".format(model))
+
 print("ALL TESTS PASSED SUCCESSFULLY")